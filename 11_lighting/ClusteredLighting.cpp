@@ -0,0 +1,364 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include "ClusteredLighting.h"
+#include "GLState.h"
+#include "GLExtensions.h"
+#include "Frustum.h"
+#include "Uniforms.h"
+
+namespace {
+    // select forms the vectorizer turns into min and max instructions
+    inline float minf(float a, float b) {
+        return a < b ? a : b;
+    }
+    
+    inline float maxf(float a, float b) {
+        return a > b ? a : b;
+    }
+    
+    inline int clampCell(float value, unsigned int count) {
+        return (int)minf(maxf(value, 0.0f), count - 1.0f);
+    }
+    
+    // log2 of a positive normal float from its exponent and a quadratic on the mantissa, off by at most s_logError
+    inline float approximateLog2(float x) {
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        
+        // the quadratic fits log2(mantissa) + 1, the exponent takes the one back
+        float exponent = (float)((int)(bits >> 23) - 128);
+        bits = (bits & 0x007fffff) | 0x3f800000;
+        
+        float mantissa;
+        memcpy(&mantissa, &bits, sizeof(mantissa));
+        
+        return exponent + (-0.34484843f * mantissa + 2.02466578f) * mantissa - 0.67487759f;
+    }
+}
+
+ClusteredLighting::ClusteredLighting(float nearPlane, float farPlane, ThreadPool& threadPool, bool cpuBinning):
+    m_nearPlane(nearPlane),
+    m_farPlane(farPlane),
+    m_threadPool(threadPool),
+    m_lightCapacity(1),
+    m_binningTime(0.0f),
+    m_clusterLights(s_clusterCount),
+    m_grid(s_clusterCount * 2),
+    // no projection is all zeros, the first update always builds the clusters
+    m_clusterProjection(0.0f),
+    m_clusterWidth(0),
+    m_clusterHeight(0)
+{
+    glGenBuffers(1, &m_lightBuffer);
+    glGenBuffers(1, &m_gridBuffer);
+    glGenBuffers(1, &m_indexBuffer);
+    
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, m_lightBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, 2 * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+    
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, m_gridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, s_clusterCount * 2 * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+    
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, m_indexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, s_indexCapacity * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+    
+    m_lightTexture = createTexture(m_lightBuffer, GL_RGBA32F);
+    m_gridTexture = createTexture(m_gridBuffer, GL_RG32UI);
+    m_indexTexture = createTexture(m_indexBuffer, GL_R32UI);
+    
+    std::cout << "[INFO] Clustered lighting: " << s_gridX << "x" << s_gridY << "x" << s_gridZ << " clusters, ";
+    
+    if (cpuBinning || !GLExtensions::gpuDriven) {
+        std::cout << "binned on the CPU with " << m_threadPool.threadCount() << " threads" << std::endl;
+        return;
+    }
+    
+    m_cullProgram.reset(new Shader("./shaders/light-cluster-cs.glsl"));
+    m_cullProgram->bindUniformBlock("Clusters", ClusterUniforms::binding);
+    
+    glGenBuffers(1, &m_counterBuffer);
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+    
+    std::cout << "binned on the GPU" << std::endl;
+}
+
+void ClusteredLighting::update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, int width, int height, StreamBuffer& stream) {
+    Frustum frustum(projection * view);
+    
+    // lights outside the view can't reach a cluster, drop them before binning
+    m_lights.clear();
+    
+    for (const Light& light : lights) {
+        if (!frustum.intersects(light.position, light.radius)) continue;
+        
+        m_lights.push_back(glm::vec4(glm::vec3(view * glm::vec4(light.position, 1.0f)), light.radius));
+        m_lights.push_back(glm::vec4(light.color * light.intensity, (float)light.shadowMap));
+    }
+    
+    unsigned int lightCount = visibleLights();
+    
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, m_lightBuffer);
+    
+    if (lightCount > m_lightCapacity) m_lightCapacity = lightCount;
+    
+    // orphan last frame's storage, the GPU may still be reading it
+    glBufferData(GL_TEXTURE_BUFFER, m_lightCapacity * 2 * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, m_lights.size() * sizeof(glm::vec4), m_lights.data());
+    
+    float logRatio = std::log(m_farPlane / m_nearPlane);
+    
+    StreamBuffer::Allocation allocation = stream.allocate(sizeof(ClusterUniforms));
+    ClusterUniforms* clusters = (ClusterUniforms*)allocation.data;
+    
+    clusters->gridSize = glm::uvec4(s_gridX, s_gridY, s_gridZ, lightCount);
+    clusters->screenSize = glm::vec4((float)width, (float)height, 0.0f, 0.0f);
+    clusters->depthSlicing = glm::vec4(s_gridZ / logRatio, -(float)s_gridZ * std::log(m_nearPlane) / logRatio, m_nearPlane, m_farPlane);
+    clusters->inverseProjection = glm::inverse(projection);
+    
+    stream.commit(allocation);
+    stream.bindRange(ClusterUniforms::binding, allocation);
+    
+    if (m_cullProgram) {
+        binOnGpu();
+    } else {
+        binOnCpu(projection, width, height);
+    }
+}
+
+void ClusteredLighting::binOnGpu() {
+    const unsigned int zero = 0;
+    
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(unsigned int), &zero);
+    
+    m_cullProgram->use();
+    m_cullProgram->setValue("indexCapacity", (int)s_indexCapacity);
+    
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_lightBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_gridBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_indexBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_counterBuffer);
+    
+    glDispatchCompute((s_clusterCount + s_groupSize - 1) / s_groupSize, 1, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void ClusteredLighting::binOnCpu(const glm::mat4& projection, int width, int height) {
+    auto start = std::chrono::steady_clock::now();
+    
+    buildClusterBounds(projection, width, height);
+    
+    unsigned int count = visibleLights();
+    
+    m_lightX.resize(count);
+    m_lightY.resize(count);
+    m_lightZ.resize(count);
+    m_lightRadius.resize(count);
+    m_tileMinX.resize(count);
+    m_tileMaxX.resize(count);
+    m_tileMinY.resize(count);
+    m_tileMaxY.resize(count);
+    m_sliceMin.resize(count);
+    m_sliceMax.resize(count);
+    
+    for (unsigned int i = 0; i < count; i++) {
+        m_lightX[i] = m_lights[2 * i].x;
+        m_lightY[i] = m_lights[2 * i].y;
+        m_lightZ[i] = m_lights[2 * i].z;
+        m_lightRadius[i] = m_lights[2 * i].w;
+    }
+    
+    // light centric: every light only visits the clusters under its screen and depth bounds
+    unsigned int batches = (count + s_boundsBatch - 1) / s_boundsBatch;
+    
+    m_threadPool.parallelFor(batches, [&](unsigned int batch) {
+        computeLightBounds(batch * s_boundsBatch, std::min(count, (batch + 1) * s_boundsBatch), projection);
+    });
+    
+    // a slice per job, no two threads ever write the same cluster list
+    m_threadPool.parallelFor(s_gridZ, [this](unsigned int slice) {
+        binSlice(slice);
+    });
+    
+    m_indices.clear();
+    
+    for (unsigned int cluster = 0; cluster < s_clusterCount; cluster++) {
+        const std::vector<unsigned int>& clusterLights = m_clusterLights[cluster];
+        unsigned int offset = (unsigned int)m_indices.size();
+        unsigned int clusterCount = std::min((unsigned int)clusterLights.size(), s_indexCapacity - offset);
+        
+        m_grid[2 * cluster] = offset;
+        m_grid[2 * cluster + 1] = clusterCount;
+        m_indices.insert(m_indices.end(), clusterLights.begin(), clusterLights.begin() + clusterCount);
+    }
+    
+    // orphan both, the previous frame may still be reading them
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, m_gridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, m_grid.size() * sizeof(unsigned int), m_grid.data(), GL_STREAM_DRAW);
+    
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, m_indexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, s_indexCapacity * sizeof(unsigned int), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, m_indices.size() * sizeof(unsigned int), m_indices.data());
+    
+    m_binningTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ClusteredLighting::buildClusterBounds(const glm::mat4& projection, int width, int height) {
+    if (projection == m_clusterProjection && width == m_clusterWidth && height == m_clusterHeight) return;
+    
+    m_clusterProjection = projection;
+    m_clusterWidth = width;
+    m_clusterHeight = height;
+    m_clusterMin.resize(s_clusterCount);
+    m_clusterMax.resize(s_clusterCount);
+    
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    
+    // same construction as light-cluster-cs.glsl: tile corner rays cut at the depths of the slice
+    auto viewRay = [&](float x, float y) {
+        glm::vec4 point = inverseProjection * glm::vec4(x * 2.0f - 1.0f, y * 2.0f - 1.0f, -1.0f, 1.0f);
+        return glm::vec3(point) / point.w;
+    };
+    
+    for (unsigned int z = 0; z < s_gridZ; z++) {
+        float zNear = m_nearPlane * std::pow(m_farPlane / m_nearPlane, (float)z / s_gridZ);
+        float zFar = m_nearPlane * std::pow(m_farPlane / m_nearPlane, (float)(z + 1) / s_gridZ);
+        
+        for (unsigned int y = 0; y < s_gridY; y++) {
+            for (unsigned int x = 0; x < s_gridX; x++) {
+                glm::vec3 rayMin = viewRay((float)x / s_gridX, (float)y / s_gridY);
+                glm::vec3 rayMax = viewRay((float)(x + 1) / s_gridX, (float)(y + 1) / s_gridY);
+                
+                glm::vec3 nearMin = rayMin * (zNear / -rayMin.z);
+                glm::vec3 nearMax = rayMax * (zNear / -rayMax.z);
+                glm::vec3 farMin = rayMin * (zFar / -rayMin.z);
+                glm::vec3 farMax = rayMax * (zFar / -rayMax.z);
+                
+                unsigned int cluster = x + s_gridX * (y + s_gridY * z);
+                
+                m_clusterMin[cluster] = glm::min(glm::min(nearMin, nearMax), glm::min(farMin, farMax));
+                m_clusterMax[cluster] = glm::max(glm::max(nearMin, nearMax), glm::max(farMin, farMax));
+            }
+        }
+    }
+}
+
+void ClusteredLighting::computeLightBounds(unsigned int begin, unsigned int end, const glm::mat4& projection) {
+    float scaleX = projection[0][0];
+    float scaleY = projection[1][1];
+    float sliceScale = s_gridZ / std::log2(m_farPlane / m_nearPlane);
+    float sliceBias = -std::log2(m_nearPlane) * sliceScale;
+    float nearPlane = m_nearPlane;
+    
+    const float* lightX = m_lightX.data();
+    const float* lightY = m_lightY.data();
+    const float* lightZ = m_lightZ.data();
+    const float* lightRadius = m_lightRadius.data();
+    int* tileMinX = m_tileMinX.data();
+    int* tileMaxX = m_tileMaxX.data();
+    int* tileMinY = m_tileMinY.data();
+    int* tileMaxY = m_tileMaxY.data();
+    int* sliceMin = m_sliceMin.data();
+    int* sliceMax = m_sliceMax.data();
+    
+    // no calls, branches or stores through members, so both loops vectorize: GCC at -O3 runs them four lights to an
+    // SSE register. Tiles and slices go in separate loops, all six outputs in one take more alias checks than the
+    // vectorizer is willing to make
+    for (unsigned int i = begin; i < end; i++) {
+        float radius = lightRadius[i];
+        float depthNear = maxf(-lightZ[i] - radius, nearPlane);
+        float depthFar = maxf(-lightZ[i] + radius, nearPlane);
+        
+        // the projected extremes of the sphere's bounding box lie on its nearest or farthest face
+        float left = lightX[i] - radius;
+        float right = lightX[i] + radius;
+        float bottom = lightY[i] - radius;
+        float top = lightY[i] + radius;
+        
+        float minX = minf(left / depthNear, left / depthFar) * scaleX;
+        float maxX = maxf(right / depthNear, right / depthFar) * scaleX;
+        float minY = minf(bottom / depthNear, bottom / depthFar) * scaleY;
+        float maxY = maxf(top / depthNear, top / depthFar) * scaleY;
+        
+        tileMinX[i] = clampCell((minX * 0.5f + 0.5f) * s_gridX, s_gridX);
+        tileMaxX[i] = clampCell((maxX * 0.5f + 0.5f) * s_gridX, s_gridX);
+        tileMinY[i] = clampCell((minY * 0.5f + 0.5f) * s_gridY, s_gridY);
+        tileMaxY[i] = clampCell((maxY * 0.5f + 0.5f) * s_gridY, s_gridY);
+    }
+    
+    for (unsigned int i = begin; i < end; i++) {
+        float depthNear = maxf(-lightZ[i] - lightRadius[i], nearPlane);
+        float depthFar = maxf(-lightZ[i] + lightRadius[i], nearPlane);
+        
+        // the approximate log can only widen the range of slices, never lose one
+        float nearSlice = approximateLog2(depthNear) * sliceScale + sliceBias - s_logError * sliceScale;
+        float farSlice = approximateLog2(depthFar) * sliceScale + sliceBias + s_logError * sliceScale;
+        
+        sliceMin[i] = clampCell(nearSlice, s_gridZ);
+        sliceMax[i] = clampCell(farSlice, s_gridZ);
+    }
+}
+
+void ClusteredLighting::binSlice(unsigned int slice) {
+    unsigned int first = slice * s_gridX * s_gridY;
+    
+    for (unsigned int cluster = first; cluster < first + s_gridX * s_gridY; cluster++) {
+        m_clusterLights[cluster].clear();
+    }
+    
+    int z = (int)slice;
+    unsigned int count = (unsigned int)m_lightX.size();
+    
+    for (unsigned int i = 0; i < count; i++) {
+        if (z < m_sliceMin[i] || z > m_sliceMax[i]) continue;
+        
+        glm::vec3 center(m_lightX[i], m_lightY[i], m_lightZ[i]);
+        float radiusSquared = m_lightRadius[i] * m_lightRadius[i];
+        
+        for (int y = m_tileMinY[i]; y <= m_tileMaxY[i]; y++) {
+            for (int x = m_tileMinX[i]; x <= m_tileMaxX[i]; x++) {
+                unsigned int cluster = first + x + s_gridX * y;
+                glm::vec3 closest = glm::clamp(center, m_clusterMin[cluster], m_clusterMax[cluster]) - center;
+                
+                if (glm::dot(closest, closest) <= radiusSquared) m_clusterLights[cluster].push_back(i);
+            }
+        }
+    }
+}
+
+void ClusteredLighting::bindTextures() {
+    GLState::bindTexture(GL_TEXTURE0 + s_lightUnit, GL_TEXTURE_BUFFER, m_lightTexture);
+    GLState::bindTexture(GL_TEXTURE0 + s_gridUnit, GL_TEXTURE_BUFFER, m_gridTexture);
+    GLState::bindTexture(GL_TEXTURE0 + s_indexUnit, GL_TEXTURE_BUFFER, m_indexTexture);
+}
+
+void ClusteredLighting::setSamplers(Shader& program) {
+    program.use();
+    program.setValue("lights", s_lightUnit);
+    program.setValue("lightGrid", s_gridUnit);
+    program.setValue("lightIndices", s_indexUnit);
+    program.bindUniformBlock("Clusters", ClusterUniforms::binding);
+}
+
+unsigned int ClusteredLighting::visibleLights() {
+    return (unsigned int)m_lights.size() / 2;
+}
+
+float ClusteredLighting::binningTime() {
+    return m_binningTime;
+}
+
+unsigned int ClusteredLighting::createTexture(unsigned int buffer, GLenum format) {
+    unsigned int texture;
+    
+    glGenTextures(1, &texture);
+    GLState::bindTexture(GL_TEXTURE0 + s_lightUnit, GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    
+    return texture;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Shader.h"
+#include "Light.h"
+#include "StreamBuffer.h"
+#include "ThreadPool.h"
+
+// Bins lights into a grid of view frustum clusters, screen tiles split into exponential depth slices.
+// Shaders find their cluster from gl_FragCoord and view depth and loop over its lights only.
+// The light list, per cluster ranges and light indices are texture buffers so GL 3.3 shaders can read them.
+// With compute shaders the binning runs on the GPU, otherwise on the CPU across the thread pool.
+class ClusteredLighting {
+public:
+    ClusteredLighting(float nearPlane, float farPlane, ThreadPool& threadPool, bool cpuBinning);
+    void update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, int width, int height, StreamBuffer& stream);
+    void bindTextures();
+    void setSamplers(Shader& program);
+    unsigned int visibleLights();
+    // CPU binning time of the last update in milliseconds, 0 when binning on the GPU
+    float binningTime();
+    
+private:
+    float m_nearPlane;
+    float m_farPlane;
+    ThreadPool& m_threadPool;
+    std::unique_ptr<Shader> m_cullProgram;
+    unsigned int m_lightBuffer;
+    unsigned int m_gridBuffer;
+    unsigned int m_indexBuffer;
+    unsigned int m_counterBuffer;
+    unsigned int m_lightTexture;
+    unsigned int m_gridTexture;
+    unsigned int m_indexTexture;
+    unsigned int m_lightCapacity;
+    float m_binningTime;
+    // two texels per visible light: view space position and radius, color times intensity and shadow map
+    std::vector<glm::vec4> m_lights;
+    
+    // CPU binning: light bounds in structure of arrays form so the bounds loop vectorizes
+    std::vector<float> m_lightX;
+    std::vector<float> m_lightY;
+    std::vector<float> m_lightZ;
+    std::vector<float> m_lightRadius;
+    std::vector<int> m_tileMinX;
+    std::vector<int> m_tileMaxX;
+    std::vector<int> m_tileMinY;
+    std::vector<int> m_tileMaxY;
+    std::vector<int> m_sliceMin;
+    std::vector<int> m_sliceMax;
+    std::vector<glm::vec3> m_clusterMin;
+    std::vector<glm::vec3> m_clusterMax;
+    std::vector<std::vector<unsigned int>> m_clusterLights;
+    std::vector<unsigned int> m_grid;
+    std::vector<unsigned int> m_indices;
+    glm::mat4 m_clusterProjection;
+    int m_clusterWidth;
+    int m_clusterHeight;
+    
+    static constexpr unsigned int s_gridX = 16;
+    static constexpr unsigned int s_gridY = 9;
+    static constexpr unsigned int s_gridZ = 24;
+    static constexpr unsigned int s_clusterCount = s_gridX * s_gridY * s_gridZ;
+    static constexpr unsigned int s_indexCapacity = s_clusterCount * 128;
+    static constexpr unsigned int s_groupSize = 128;
+    static constexpr unsigned int s_boundsBatch = 256;
+    // most the log2 approximation of the light bounds can be off by, slice ranges are widened by it
+    static constexpr float s_logError = 0.01f;
+    static constexpr int s_lightUnit = 3;
+    static constexpr int s_gridUnit = 4;
+    static constexpr int s_indexUnit = 5;
+    
+    void binOnGpu();
+    void binOnCpu(const glm::mat4& projection, int width, int height);
+    void buildClusterBounds(const glm::mat4& projection, int width, int height);
+    void computeLightBounds(unsigned int begin, unsigned int end, const glm::mat4& projection);
+    void binSlice(unsigned int slice);
+    unsigned int createTexture(unsigned int buffer, GLenum format);
+};
@@ -0,0 +1,68 @@
+#include "CommandBuffer.h"
+#include "GLState.h"
+
+CommandBuffer::CommandBuffer():
+    m_size(0),
+    m_count(0)
+{
+}
+
+void CommandBuffer::reset() {
+    m_size = 0;
+    m_count = 0;
+}
+
+void CommandBuffer::replay() const {
+    size_t offset = 0;
+    
+    while (offset < m_size) {
+        const Header* header = (const Header*)&m_arena[offset];
+        const unsigned char* data = &m_arena[offset + sizeof(Header)];
+        
+        switch (header->type) {
+            case useProgram: {
+                const UseProgram* command = (const UseProgram*)data;
+                GLState::useProgram(command->program);
+                break;
+            }
+            case bindVertexArray: {
+                const BindVertexArray* command = (const BindVertexArray*)data;
+                GLState::bindVertexArray(command->vao);
+                break;
+            }
+            case bindTexture: {
+                const BindTexture* command = (const BindTexture*)data;
+                GLState::bindTexture(command->unit, command->target, command->texture);
+                break;
+            }
+            case bindBufferRange: {
+                const BindBufferRange* command = (const BindBufferRange*)data;
+                GLState::bindBufferRange(command->target, command->index, command->buffer, command->offset, command->size);
+                break;
+            }
+            case drawElements: {
+                const DrawElements* command = (const DrawElements*)data;
+                glDrawElements(GL_TRIANGLES, command->count, command->indexType, command->indices);
+                break;
+            }
+            case beginConditionalRender: {
+                const BeginConditionalRender* command = (const BeginConditionalRender*)data;
+                glBeginConditionalRender(command->query, command->mode);
+                break;
+            }
+            case endConditionalRender:
+                glEndConditionalRender();
+                break;
+        }
+        
+        offset += header->size;
+    }
+}
+
+unsigned int CommandBuffer::count() const {
+    return m_count;
+}
+
+size_t CommandBuffer::size() const {
+    return m_size;
+}
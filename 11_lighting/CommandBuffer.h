@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include <glad/glad.h>
+
+// GL commands recorded without touching GL and replayed later on the thread owning the context, so preparing draws
+// can be split over worker threads that each record a buffer of their own. Commands are plain structs stored one
+// after another behind a small header in a linear arena. reset() only rewinds it, so once the arena has grown to
+// the size of a frame, recording allocates nothing.
+class CommandBuffer {
+public:
+    enum Type : uint32_t {
+        useProgram,
+        bindVertexArray,
+        bindTexture,
+        bindBufferRange,
+        drawElements,
+        beginConditionalRender,
+        endConditionalRender
+    };
+    
+    struct UseProgram {
+        static constexpr Type type = useProgram;
+        unsigned int program;
+    };
+    
+    struct BindVertexArray {
+        static constexpr Type type = bindVertexArray;
+        unsigned int vao;
+    };
+    
+    struct BindTexture {
+        static constexpr Type type = bindTexture;
+        GLenum unit;
+        GLenum target;
+        unsigned int texture;
+    };
+    
+    struct BindBufferRange {
+        static constexpr Type type = bindBufferRange;
+        GLenum target;
+        unsigned int index;
+        unsigned int buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+    
+    struct DrawElements {
+        static constexpr Type type = drawElements;
+        GLsizei count;
+        GLenum indexType;
+        const void* indices;
+    };
+    
+    struct BeginConditionalRender {
+        static constexpr Type type = beginConditionalRender;
+        unsigned int query;
+        GLenum mode;
+    };
+    
+    struct EndConditionalRender {
+        static constexpr Type type = endConditionalRender;
+    };
+    
+    CommandBuffer();
+    template <typename Command>
+    void record(const Command& command);
+    void reset();
+    // on the GL thread only, every bind goes through GLState
+    void replay() const;
+    unsigned int count() const;
+    // bytes recorded
+    size_t size() const;
+    
+private:
+    struct Header {
+        Type type;
+        uint32_t size;
+    };
+    
+    std::vector<unsigned char> m_arena;
+    size_t m_size;
+    unsigned int m_count;
+    
+    // keeps every command aligned for its widest member
+    static constexpr size_t s_alignment = 8;
+};
+
+template <typename Command>
+void CommandBuffer::record(const Command& command) {
+    static_assert(std::is_trivially_copyable<Command>::value, "commands are copied as bytes");
+    
+    size_t size = (sizeof(Header) + sizeof(Command) + s_alignment - 1) / s_alignment * s_alignment;
+    
+    if (m_size + size > m_arena.size()) m_arena.resize(std::max(2 * m_arena.size(), m_size + size));
+    
+    Header header = { Command::type, (uint32_t)size };
+    
+    memcpy(&m_arena[m_size], &header, sizeof(Header));
+    memcpy(&m_arena[m_size + sizeof(Header)], &command, sizeof(Command));
+    
+    m_size += size;
+    m_count++;
+}
@@ -0,0 +1,146 @@
+#include <cmath>
+#include <cstddef>
+#include <glm/gtc/constants.hpp>
+#include "DeferredLighting.h"
+#include "GLState.h"
+#include "Uniforms.h"
+#include "ShadowMaps.h"
+
+DeferredLighting::DeferredLighting():
+    m_volume(volumeVertices().data(), (unsigned int)volumeVertices().size() / 8, VertexFormat::compact()),
+    m_ambientProgram("./shaders/fullscreen-vs.glsl", "./shaders/deferred-ambient-fs.glsl"),
+    m_lightProgram("./shaders/deferred-light-vs.glsl", "./shaders/deferred-light-fs.glsl"),
+    m_capacity(0)
+{
+    m_lightProgram.bindUniformBlock("Frame", FrameUniforms::binding);
+    
+    Shader* programs[] = { &m_ambientProgram, &m_lightProgram };
+    
+    for (Shader* program : programs) {
+        program->use();
+        program->setValue("gAlbedo", 0);
+        program->setValue("gNormal", 1);
+        program->setValue("gDepth", 2);
+    }
+    
+    ShadowMaps::setSamplers(m_lightProgram);
+    
+    glGenVertexArrays(1, &m_volumeVAO);
+    GLState::bindVertexArray(m_volumeVAO);
+    
+    m_volume.setAttributes();
+    
+    glGenBuffers(1, &m_lightVBO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_lightVBO);
+    
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Light), (void*)offsetof(Light, position));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Light), (void*)offsetof(Light, color));
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+    
+    glVertexAttribIPointer(5, 1, GL_INT, sizeof(Light), (void*)offsetof(Light, shadowMap));
+    glEnableVertexAttribArray(5);
+    glVertexAttribDivisor(5, 1);
+    
+    // the fullscreen triangle is generated from gl_VertexID, core profile still wants a VAO bound
+    glGenVertexArrays(1, &m_fullscreenVAO);
+    
+    GLState::bindVertexArray(0);
+}
+
+void DeferredLighting::render(FrameGraph& graph, const GBuffer& gbuffer, const std::vector<Light>& lights, const glm::mat4& projection, const glm::vec3& ambient) {
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    
+    gbuffer.bindTextures(graph);
+    
+    // ambient, and depth for the light volumes and anything drawn forward afterwards
+    GLState::setDepthFunc(GL_ALWAYS);
+    
+    m_ambientProgram.use();
+    m_ambientProgram.setValue("ambient", ambient);
+    
+    GLState::bindVertexArray(m_fullscreenVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    
+    if (!lights.empty()) {
+        GLState::bindBuffer(GL_ARRAY_BUFFER, m_lightVBO);
+        
+        if (lights.size() > m_capacity) {
+            m_capacity = (unsigned int)lights.size();
+            glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(Light), lights.data(), GL_STREAM_DRAW);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(Light), NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, lights.size() * sizeof(Light), lights.data());
+        }
+        
+        // back faces behind the stored depth cover exactly the pixels whose surface lies inside the volume,
+        // wherever the camera is. Depth clamp keeps volumes that cross the far plane whole
+        GLState::setDepthFunc(GL_GEQUAL);
+        GLState::setDepthMask(false);
+        GLState::setDepthClamp(true);
+        GLState::setCullFace(true);
+        GLState::setCullMode(GL_FRONT);
+        GLState::setBlend(true);
+        GLState::setBlendFunc(GL_ONE, GL_ONE);
+        
+        m_lightProgram.use();
+        m_lightProgram.setValue("inverseProjection", inverseProjection);
+        
+        GLState::bindVertexArray(m_volumeVAO);
+        glDrawElementsInstanced(GL_TRIANGLES, m_volume.indexCount(), m_volume.indexType(), (void*)0, (GLsizei)lights.size());
+        
+        GLState::setBlend(false);
+        GLState::setCullFace(false);
+        GLState::setDepthClamp(false);
+        GLState::setDepthMask(true);
+    }
+    
+    GLState::setDepthFunc(GL_LESS);
+}
+
+const std::vector<float>& DeferredLighting::volumeVertices() {
+    static std::vector<float> vertices;
+    
+    if (!vertices.empty()) return vertices;
+    
+    // the flat faces of a tessellated sphere sit inside the true sphere, push them out until they enclose it
+    const float pi = glm::pi<float>();
+    const float scale = 1.0f / (std::cos(pi / s_segments) * std::cos(pi / s_rings));
+    
+    auto point = [&](int ring, int segment) {
+        float theta = pi * ring / s_rings;
+        float phi = 2.0f * pi * segment / s_segments;
+        
+        return glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+    };
+    
+    auto push = [&](const glm::vec3& normal) {
+        glm::vec3 position = normal * scale;
+        const float vertex[] = { position.x, position.y, position.z, normal.x, normal.y, normal.z, 0.0f, 0.0f };
+        
+        vertices.insert(vertices.end(), vertex, vertex + 8);
+    };
+    
+    for (int ring = 0; ring < s_rings; ring++) {
+        for (int segment = 0; segment < s_segments; segment++) {
+            glm::vec3 a = point(ring, segment);
+            glm::vec3 b = point(ring + 1, segment);
+            glm::vec3 c = point(ring + 1, segment + 1);
+            glm::vec3 d = point(ring, segment + 1);
+            
+            // counter clockwise seen from outside
+            if (ring > 0) {
+                push(a); push(d); push(c);
+            }
+            
+            if (ring < s_rings - 1) {
+                push(a); push(c); push(b);
+            }
+        }
+    }
+    
+    return vertices;
+}
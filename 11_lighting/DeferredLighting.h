@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Shader.h"
+#include "Mesh.h"
+#include "GBuffer.h"
+#include "Light.h"
+
+// Lighting pass of the deferred path. A fullscreen pass applies ambient light and copies the G-buffer depth into
+// the bound framebuffer, then every light draws its bounding sphere and shades only the pixels inside it.
+class DeferredLighting {
+public:
+    DeferredLighting();
+    void render(FrameGraph& graph, const GBuffer& gbuffer, const std::vector<Light>& lights, const glm::mat4& projection, const glm::vec3& ambient);
+    
+private:
+    Mesh m_volume;
+    Shader m_ambientProgram;
+    Shader m_lightProgram;
+    unsigned int m_volumeVAO;
+    unsigned int m_fullscreenVAO;
+    unsigned int m_lightVBO;
+    unsigned int m_capacity;
+    
+    static constexpr int s_segments = 16;
+    static constexpr int s_rings = 8;
+    
+    static const std::vector<float>& volumeVertices();
+};
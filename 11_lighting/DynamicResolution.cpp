@@ -0,0 +1,138 @@
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include "DynamicResolution.h"
+#include "GLState.h"
+
+DynamicResolution::DynamicResolution(float budget, Upscale upscale):
+    m_program("./shaders/fullscreen-vs.glsl", "./shaders/upscale-fs.glsl"),
+    m_upscale(upscale),
+    m_budget(budget),
+    m_scale(1.0f),
+    m_gpuTime(0.0f),
+    m_windowWidth(0),
+    m_windowHeight(0),
+    m_width(0),
+    m_height(0),
+    m_frame(0),
+    m_cheapFrames(0),
+    m_timing(false)
+{
+    glGenQueries(s_queryFrames, m_queries);
+    
+    for (unsigned int i = 0; i < s_queryFrames; i++) {
+        m_queryPending[i] = false;
+        m_queryScale[i] = 0.0f;
+    }
+    
+    // the fullscreen triangle is generated from gl_VertexID, core profile still wants a VAO bound
+    glGenVertexArrays(1, &m_VAO);
+    
+    m_program.use();
+    m_program.setValue("source", 0);
+}
+
+void DynamicResolution::beginFrame(int width, int height) {
+    unsigned int slot = m_frame % s_queryFrames;
+    
+    // the oldest query comes back around, its result is in by now unless the GPU is that far behind
+    if (m_queryPending[slot]) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(m_queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        
+        if (available) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(m_queries[slot], GL_QUERY_RESULT, &elapsed);
+            
+            m_queryPending[slot] = false;
+            m_gpuTime = elapsed / 1000000.0f;
+            
+            if (m_queryScale[slot] == m_scale) adjust(m_gpuTime);
+        }
+    }
+    
+    m_windowWidth = width;
+    m_windowHeight = height;
+    m_width = std::max((int)(width * m_scale + 0.5f), 1);
+    m_height = std::max((int)(height * m_scale + 0.5f), 1);
+    
+    // a frame without a free query goes untimed, as do the first ones which pay for driver warm up
+    m_timing = !m_queryPending[slot] && m_frame >= s_warmupFrames;
+    
+    if (m_timing) {
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[slot]);
+        m_queryScale[slot] = m_scale;
+    }
+}
+
+int DynamicResolution::width() {
+    return m_width;
+}
+
+int DynamicResolution::height() {
+    return m_height;
+}
+
+float DynamicResolution::scale() {
+    return m_scale;
+}
+
+float DynamicResolution::gpuTime() {
+    return m_gpuTime;
+}
+
+void DynamicResolution::upscale(unsigned int texture) {
+    GLState::setDepthTest(false);
+    GLState::setDepthMask(false);
+    
+    m_program.use();
+    m_program.setValue("sourceSize", glm::vec2(m_width, m_height));
+    m_program.setValue("targetSize", glm::vec2(m_windowWidth, m_windowHeight));
+    // at full scale the copy is one to one and left alone
+    m_program.setValue("sharpness", m_upscale == sharpen && m_scale < 1.0f ? s_sharpness : 0.0f);
+    
+    GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, texture);
+    GLState::bindVertexArray(m_VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    
+    GLState::setDepthMask(true);
+    GLState::setDepthTest(true);
+}
+
+void DynamicResolution::endFrame() {
+    if (m_timing) {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_queryPending[m_frame % s_queryFrames] = true;
+    }
+    
+    m_frame++;
+}
+
+void DynamicResolution::adjust(float gpuTime) {
+    float scale = m_scale;
+    
+    // drop at once, by what GPU time following the pixel count says it takes
+    if (gpuTime > m_budget) {
+        scale *= std::sqrt(s_targetShare * m_budget / gpuTime);
+        scale = std::floor(scale / s_scaleStep) * s_scaleStep;
+        m_cheapFrames = 0;
+    } else if (gpuTime < s_raiseShare * m_budget) {
+        // raise a step at a time, and only after a run of cheap frames, so noise does not make it oscillate
+        if (++m_cheapFrames < s_raiseFrames) return;
+        
+        scale += s_scaleStep;
+        m_cheapFrames = 0;
+    } else {
+        m_cheapFrames = 0;
+        return;
+    }
+    
+    scale = glm::clamp(scale, s_minScale, 1.0f);
+    
+    if (std::abs(scale - m_scale) < 0.5f * s_scaleStep) return;
+    
+    std::cout << "[INFO] Dynamic resolution: scale " << m_scale << " -> " << scale << " after a " << gpuTime << " ms frame (budget "
+              << m_budget << " ms), " << (int)(m_windowWidth * scale + 0.5f) << "x" << (int)(m_windowHeight * scale + 0.5f) << std::endl;
+    
+    m_scale = scale;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "Shader.h"
+
+// Renders the scene offscreen at a share of the window size and scales it up to the window at the end of the frame.
+// GL_TIME_ELAPSED queries time every frame on the GPU and are read a few frames late once available. The scale drops
+// as soon as a frame goes over the budget, as far as the pixel count says it must, and comes back up a step at a time
+// once frames stay well under it. The scene target comes from the frame graph at the render size, its pool keeps
+// the textures of recent scales around so stepping back and forth does not reallocate.
+class DynamicResolution {
+public:
+    enum Upscale { bilinear, sharpen };
+    
+    // budget is the GPU time per frame to hold, in milliseconds
+    DynamicResolution(float budget, Upscale upscale);
+    // picks the render size for a window of width x height and starts timing the frame
+    void beginFrame(int width, int height);
+    int width();
+    int height();
+    float scale();
+    // milliseconds, of the latest frame whose result arrived
+    float gpuTime();
+    // scales a render size texture into the bound framebuffer, which has the window size
+    void upscale(unsigned int texture);
+    // stops timing the frame, after the upscale
+    void endFrame();
+    
+private:
+    Shader m_program;
+    Upscale m_upscale;
+    float m_budget;
+    float m_scale;
+    float m_gpuTime;
+    unsigned int m_VAO;
+    int m_windowWidth;
+    int m_windowHeight;
+    int m_width;
+    int m_height;
+    unsigned int m_frame;
+    // results under the raise share in a row
+    unsigned int m_cheapFrames;
+    bool m_timing;
+    static constexpr unsigned int s_queryFrames = 3;
+    
+    unsigned int m_queries[s_queryFrames];
+    bool m_queryPending[s_queryFrames];
+    // the scale each query measured, results of another scale than the current one are ignored
+    float m_queryScale[s_queryFrames];
+    
+    static constexpr float s_minScale = 0.5f;
+    static constexpr float s_scaleStep = 0.05f;
+    // aim for this share of the budget when dropping, raise only below the second
+    static constexpr float s_targetShare = 0.9f;
+    static constexpr float s_raiseShare = 0.75f;
+    static constexpr unsigned int s_raiseFrames = 30;
+    static constexpr float s_sharpness = 0.2f;
+    static constexpr unsigned int s_warmupFrames = 3;
+    
+    void adjust(float gpuTime);
+};
@@ -0,0 +1,324 @@
+#include <iostream>
+#include <algorithm>
+#include "FrameGraph.h"
+#include "GLState.h"
+
+FrameGraph::Builder::Builder(FrameGraph& graph, unsigned int pass):
+    m_graph(graph),
+    m_pass(pass)
+{
+}
+
+FrameGraph::Resource FrameGraph::Builder::create(const std::string& name, const TextureDesc& desc) {
+    ResourceNode resource = { name, desc, -1, 0, 0, 0 };
+    
+    m_graph.m_resources.push_back(resource);
+    
+    return write((Resource)m_graph.m_resources.size() - 1);
+}
+
+FrameGraph::Resource FrameGraph::Builder::read(Resource resource) {
+    std::vector<Resource>& reads = m_graph.m_passes[m_pass].reads;
+    
+    if (std::find(reads.begin(), reads.end(), resource) == reads.end()) reads.push_back(resource);
+    
+    return resource;
+}
+
+FrameGraph::Resource FrameGraph::Builder::write(Resource resource) {
+    std::vector<Resource>& writes = m_graph.m_passes[m_pass].writes;
+    
+    if (std::find(writes.begin(), writes.end(), resource) == writes.end()) writes.push_back(resource);
+    
+    return resource;
+}
+
+void FrameGraph::Builder::sideEffect() {
+    m_graph.m_passes[m_pass].sideEffect = true;
+}
+
+void FrameGraph::Builder::compute() {
+    m_graph.m_passes[m_pass].compute = true;
+}
+
+FrameGraph::FrameGraph() {
+    m_stats = Stats();
+}
+
+void FrameGraph::reset() {
+    m_resources.clear();
+    m_passes.clear();
+}
+
+FrameGraph::Resource FrameGraph::importFramebuffer(const std::string& name, unsigned int framebuffer, int width, int height) {
+    ResourceNode resource = { name, { width, height, GL_RGBA8 }, (int)framebuffer, 0, 0, 0 };
+    
+    m_resources.push_back(resource);
+    
+    return (Resource)m_resources.size() - 1;
+}
+
+void FrameGraph::addPass(const std::string& name, const std::function<void(Builder&)>& setup, const std::function<void()>& execute) {
+    PassNode pass;
+    pass.name = name;
+    pass.execute = execute;
+    pass.sideEffect = false;
+    pass.compute = false;
+    pass.culled = false;
+    
+    m_passes.push_back(pass);
+    
+    Builder builder(*this, (unsigned int)m_passes.size() - 1);
+    setup(builder);
+}
+
+void FrameGraph::compile() {
+    std::vector<bool> needed(m_resources.size(), false);
+    
+    m_stats = Stats();
+    m_stats.passes = (unsigned int)m_passes.size();
+    
+    // readers come after writers, so walking backwards sees every use of a resource before the passes producing it
+    for (unsigned int i = (unsigned int)m_passes.size(); i-- > 0;) {
+        PassNode& pass = m_passes[i];
+        bool live = pass.sideEffect;
+        
+        for (Resource resource : pass.writes) {
+            if (needed[resource] || m_resources[resource].framebuffer >= 0) live = true;
+        }
+        
+        pass.culled = !live;
+        
+        if (!live) {
+            m_stats.culled++;
+            continue;
+        }
+        
+        for (Resource resource : pass.reads) needed[resource] = true;
+    }
+    
+    for (ResourceNode& resource : m_resources) {
+        resource.firstPass = ~0u;
+        resource.lastPass = 0;
+    }
+    
+    for (unsigned int i = 0; i < m_passes.size(); i++) {
+        const PassNode& pass = m_passes[i];
+        
+        if (pass.culled) continue;
+        
+        for (const std::vector<Resource>* uses : { &pass.reads, &pass.writes }) {
+            for (Resource resource : *uses) {
+                m_resources[resource].firstPass = std::min(m_resources[resource].firstPass, i);
+                m_resources[resource].lastPass = std::max(m_resources[resource].lastPass, i);
+            }
+        }
+    }
+    
+    for (const ResourceNode& resource : m_resources) {
+        if (resource.framebuffer >= 0 || resource.firstPass == ~0u) continue;
+        
+        m_stats.transients++;
+        m_stats.unaliasedMemory += bytes(resource.desc);
+    }
+}
+
+void FrameGraph::execute() {
+    for (PooledTexture& pooled : m_pool) pooled.idleFrames++;
+    
+    for (unsigned int i = 0; i < m_passes.size(); i++) {
+        const PassNode& pass = m_passes[i];
+        
+        if (pass.culled) continue;
+        
+        for (ResourceNode& resource : m_resources) {
+            if (resource.framebuffer < 0 && resource.firstPass == i) resource.texture = acquire(resource.desc);
+        }
+        
+        if (!pass.compute) bindTargets(pass);
+        
+        pass.execute();
+        
+        for (const ResourceNode& resource : m_resources) {
+            if (resource.framebuffer < 0 && resource.lastPass == i && resource.firstPass != ~0u) release(resource.texture);
+        }
+    }
+    
+    m_stats.textures = 0;
+    m_stats.peakMemory = 0;
+    
+    for (const PooledTexture& texture : m_pool) {
+        if (texture.idleFrames > 0) continue;
+        
+        m_stats.textures++;
+        m_stats.peakMemory += bytes(texture.desc);
+    }
+    
+    trimPool();
+}
+
+unsigned int FrameGraph::texture(Resource resource) {
+    return m_resources[resource].texture;
+}
+
+const FrameGraph::TextureDesc& FrameGraph::desc(Resource resource) {
+    return m_resources[resource].desc;
+}
+
+FrameGraph::Stats FrameGraph::stats() {
+    return m_stats;
+}
+
+bool FrameGraph::isDepth(GLenum internalFormat) {
+    return internalFormat == GL_DEPTH_COMPONENT16 || internalFormat == GL_DEPTH_COMPONENT24 ||
+           internalFormat == GL_DEPTH_COMPONENT32F || internalFormat == GL_DEPTH_COMPONENT;
+}
+
+size_t FrameGraph::bytes(const TextureDesc& desc) {
+    size_t texel = 4;
+    
+    switch (desc.internalFormat) {
+        case GL_R8: texel = 1; break;
+        case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: texel = 2; break;
+        case GL_RGBA16F: case GL_RG32F: texel = 8; break;
+        case GL_RGBA32F: texel = 16; break;
+    }
+    
+    return texel * desc.width * desc.height;
+}
+
+unsigned int FrameGraph::acquire(const TextureDesc& desc) {
+    for (PooledTexture& pooled : m_pool) {
+        if (pooled.used || pooled.desc.width != desc.width || pooled.desc.height != desc.height ||
+            pooled.desc.internalFormat != desc.internalFormat) continue;
+        
+        pooled.used = true;
+        pooled.idleFrames = 0;
+        
+        return pooled.texture;
+    }
+    
+    PooledTexture pooled = { 0, desc, true, 0 };
+    bool depth = isDepth(desc.internalFormat);
+    
+    glGenTextures(1, &pooled.texture);
+    GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, pooled.texture);
+    // the data is NULL, any format of the right kind does
+    glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, depth ? GL_DEPTH_COMPONENT : GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    
+    m_pool.push_back(pooled);
+    
+    return pooled.texture;
+}
+
+void FrameGraph::release(unsigned int texture) {
+    for (PooledTexture& pooled : m_pool) {
+        if (pooled.texture == texture) pooled.used = false;
+    }
+}
+
+void FrameGraph::bindTargets(const PassNode& pass) {
+    std::vector<unsigned int> colors;
+    unsigned int depth = 0;
+    const TextureDesc* size = NULL;
+    
+    for (Resource id : pass.writes) {
+        const ResourceNode& resource = m_resources[id];
+        
+        if (resource.framebuffer >= 0) {
+            if (pass.writes.size() > 1) std::cout << "[ERROR] Frame graph: pass " << pass.name << " writes " << resource.name << " and other targets" << std::endl;
+            
+            GLState::bindFramebuffer(resource.framebuffer);
+            glViewport(0, 0, resource.desc.width, resource.desc.height);
+            
+            return;
+        }
+        
+        if (isDepth(resource.desc.internalFormat)) {
+            depth = resource.texture;
+        } else {
+            colors.push_back(resource.texture);
+        }
+        
+        if (size == NULL) size = &resource.desc;
+    }
+    
+    // passes writing nothing leave the binding alone
+    if (size == NULL) return;
+    
+    if (depth != 0) colors.push_back(depth);
+    
+    GLState::bindFramebuffer(framebuffer(colors, depth != 0));
+    glViewport(0, 0, size->width, size->height);
+}
+
+unsigned int FrameGraph::framebuffer(const std::vector<unsigned int>& attachments, bool depth) {
+    auto found = m_framebuffers.find(attachments);
+    
+    if (found != m_framebuffers.end()) return found->second;
+    
+    unsigned int ID;
+    std::vector<GLenum> drawBuffers;
+    unsigned int colorCount = (unsigned int)attachments.size() - (depth ? 1 : 0);
+    
+    glGenFramebuffers(1, &ID);
+    GLState::bindFramebuffer(ID);
+    
+    for (unsigned int i = 0; i < colorCount; i++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, attachments[i], 0);
+        drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+    }
+    
+    if (depth) glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, attachments.back(), 0);
+    
+    // depth only targets draw no color at all
+    if (drawBuffers.empty()) {
+        glDrawBuffer(GL_NONE);
+    } else {
+        glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+    }
+    
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "[ERROR] Frame graph framebuffer is incomplete" << std::endl;
+    }
+    
+    m_framebuffers[attachments] = ID;
+    
+    return ID;
+}
+
+void FrameGraph::trimPool() {
+    bool deleted = false;
+    
+    for (unsigned int i = 0; i < m_pool.size();) {
+        if (m_pool[i].idleFrames < s_maxIdleFrames) {
+            i++;
+            continue;
+        }
+        
+        unsigned int texture = m_pool[i].texture;
+        
+        for (auto framebuffer = m_framebuffers.begin(); framebuffer != m_framebuffers.end();) {
+            const std::vector<unsigned int>& attachments = framebuffer->first;
+            
+            if (std::find(attachments.begin(), attachments.end(), texture) == attachments.end()) {
+                ++framebuffer;
+                continue;
+            }
+            
+            glDeleteFramebuffers(1, &framebuffer->second);
+            framebuffer = m_framebuffers.erase(framebuffer);
+        }
+        
+        glDeleteTextures(1, &texture);
+        m_pool.erase(m_pool.begin() + i);
+        deleted = true;
+    }
+    
+    // deleting unbinds whatever was bound, and a new object may get the same name
+    if (deleted) GLState::invalidate();
+}
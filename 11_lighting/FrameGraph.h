@@ -0,0 +1,118 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+// Passes of a frame and the render targets between them, rebuilt every frame. Each pass declares what it reads and
+// writes in a setup callback; compile() drops the passes nothing that leaves the frame depends on and works out when
+// every transient target is first and last used. Passes run in the order they were added, a handle only exists once
+// its writer was added so that order always works. Transient targets come out of a pool when their first pass runs
+// and go back after their last one, so targets that are never alive at the same time share one texture. GL cannot
+// place textures of different formats in the same memory, the pool matches on format and size.
+class FrameGraph {
+public:
+    typedef int Resource;
+    
+    static constexpr Resource none = -1;
+    
+    struct TextureDesc {
+        int width;
+        int height;
+        GLenum internalFormat;
+    };
+    
+    struct Stats {
+        unsigned int passes;
+        unsigned int culled;
+        unsigned int transients;
+        // pooled textures the transients of the frame were placed in
+        unsigned int textures;
+        // bytes, with and without sharing
+        size_t peakMemory;
+        size_t unaliasedMemory;
+    };
+    
+    class Builder {
+    public:
+        Resource create(const std::string& name, const TextureDesc& desc);
+        Resource read(Resource resource);
+        Resource write(Resource resource);
+        // the pass does something outside the graph and always runs
+        void sideEffect();
+        // the pass writes through image stores, no targets are bound for it
+        void compute();
+    
+    private:
+        friend class FrameGraph;
+        
+        FrameGraph& m_graph;
+        unsigned int m_pass;
+        
+        Builder(FrameGraph& graph, unsigned int pass);
+    };
+    
+    FrameGraph();
+    // drops the passes and resources of the previous frame, pooled textures stay
+    void reset();
+    // a framebuffer owned elsewhere, 0 for the window; passes writing it always run
+    Resource importFramebuffer(const std::string& name, unsigned int framebuffer, int width, int height);
+    void addPass(const std::string& name, const std::function<void(Builder&)>& setup, const std::function<void()>& execute);
+    void compile();
+    // runs the passes left, each with the targets it writes bound and the viewport set to their size
+    void execute();
+    // texture behind a transient, only valid while the passes that use it run
+    unsigned int texture(Resource resource);
+    const TextureDesc& desc(Resource resource);
+    Stats stats();
+    
+private:
+    struct ResourceNode {
+        std::string name;
+        TextureDesc desc;
+        // framebuffer of imported resources, -1 for transients
+        int framebuffer;
+        unsigned int texture;
+        unsigned int firstPass;
+        unsigned int lastPass;
+    };
+    
+    struct PassNode {
+        std::string name;
+        std::function<void()> execute;
+        std::vector<Resource> reads;
+        std::vector<Resource> writes;
+        bool sideEffect;
+        bool compute;
+        bool culled;
+    };
+    
+    struct PooledTexture {
+        unsigned int texture;
+        TextureDesc desc;
+        bool used;
+        // frames since it was last used
+        unsigned int idleFrames;
+    };
+    
+    std::vector<ResourceNode> m_resources;
+    std::vector<PassNode> m_passes;
+    std::vector<PooledTexture> m_pool;
+    // framebuffers by their attachments, color first and depth last
+    std::map<std::vector<unsigned int>, unsigned int> m_framebuffers;
+    Stats m_stats;
+    
+    // pooled textures not used for this many frames are deleted, mostly old sizes after a resize
+    static constexpr unsigned int s_maxIdleFrames = 60;
+    
+    static bool isDepth(GLenum internalFormat);
+    static size_t bytes(const TextureDesc& desc);
+    
+    unsigned int acquire(const TextureDesc& desc);
+    void release(unsigned int texture);
+    void bindTargets(const PassNode& pass);
+    unsigned int framebuffer(const std::vector<unsigned int>& attachments, bool depth);
+    void trimPool();
+};
@@ -0,0 +1,117 @@
+#include <thread>
+#include <algorithm>
+#include "FramePacer.h"
+
+static float milliseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+FramePacer::FramePacer(float frameLimit):
+    m_period(frameLimit > 0.0f ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameLimit)) : Clock::duration::zero()),
+    m_deadline(Clock::now()),
+    m_presented(false),
+    m_frame(0),
+    m_totals(),
+    m_gpuFrames(0)
+{
+    for (unsigned int i = 0; i < s_queryFrames; i++) {
+        glGenQueries(2, m_queries[i]);
+        m_queryPending[i] = false;
+    }
+}
+
+void FramePacer::beginFrame() {
+    m_frameStart = Clock::now();
+    
+    unsigned int slot = m_frame % s_queryFrames;
+    
+    readQueries(slot);
+    
+    // a slot still in flight leaves this frame untimed on the GPU
+    if (!m_queryPending[slot]) glQueryCounter(m_queries[slot][0], GL_TIMESTAMP);
+}
+
+void FramePacer::endFrame() {
+    unsigned int slot = m_frame % s_queryFrames;
+    
+    if (!m_queryPending[slot]) {
+        glQueryCounter(m_queries[slot][1], GL_TIMESTAMP);
+        m_queryPending[slot] = true;
+    }
+    
+    m_frame++;
+    
+    Clock::time_point now = Clock::now();
+    
+    m_totals.cpuTime += milliseconds(now - m_frameStart);
+    m_totals.frames++;
+    
+    if (m_period == Clock::duration::zero()) return;
+    
+    // hand the frame to the GPU before sleeping, or it would sit in the command queue until the swap
+    glFlush();
+    
+    m_deadline += m_period;
+    
+    // more than a frame behind, start over from now rather than rushing frames out to catch up
+    if (m_deadline + m_period < now) m_deadline = now;
+    
+    Clock::duration spinMargin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli>(s_spinMargin));
+    
+    if (m_deadline - now > spinMargin) std::this_thread::sleep_for(m_deadline - now - spinMargin);
+    
+    while (Clock::now() < m_deadline) std::this_thread::yield();
+    
+    m_totals.waitTime += milliseconds(Clock::now() - now);
+}
+
+void FramePacer::presented() {
+    Clock::time_point now = Clock::now();
+    
+    if (m_presented) {
+        float interval = milliseconds(now - m_lastPresent);
+        
+        m_totals.presentInterval += interval;
+        m_totals.maxPresentInterval = std::max(m_totals.maxPresentInterval, interval);
+    }
+    
+    m_lastPresent = now;
+    m_presented = true;
+}
+
+FramePacer::Stats FramePacer::stats() {
+    Stats stats = m_totals;
+    
+    if (stats.frames > 0) {
+        stats.cpuTime /= stats.frames;
+        stats.presentInterval /= stats.frames;
+        stats.waitTime /= stats.frames;
+    }
+    
+    if (m_gpuFrames > 0) stats.gpuTime /= m_gpuFrames;
+    
+    return stats;
+}
+
+void FramePacer::resetStats() {
+    m_totals = Stats();
+    m_gpuFrames = 0;
+}
+
+void FramePacer::readQueries(unsigned int slot) {
+    if (!m_queryPending[slot]) return;
+    
+    GLuint available = 0;
+    glGetQueryObjectuiv(m_queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    
+    if (!available) return;
+    
+    GLuint64 start = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(m_queries[slot][0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(m_queries[slot][1], GL_QUERY_RESULT, &end);
+    
+    m_queryPending[slot] = false;
+    m_totals.gpuTime += (end - start) / 1000000.0f;
+    m_gpuFrames++;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <glad/glad.h>
+
+// Keeps frames from coming faster than needed and measures how they are delivered. With a frame limit the end of every
+// frame waits for its deadline, sleeping while there is time left and spinning only for the last stretch, where sleep
+// is too coarse to hit it. GPU time comes from timestamp queries around the frame, read a few frames late once
+// available, so they never collide with the elapsed time queries of dynamic resolution.
+class FramePacer {
+public:
+    // averages in milliseconds since the last reset
+    struct Stats {
+        unsigned int frames;
+        // from beginFrame() to endFrame(), without the limiter
+        float cpuTime;
+        float gpuTime;
+        // between consecutive presented() calls
+        float presentInterval;
+        float maxPresentInterval;
+        // slept and spun by the limiter
+        float waitTime;
+    };
+    
+    // frameLimit in frames per second, 0 for none
+    FramePacer(float frameLimit);
+    void beginFrame();
+    // waits for the frame's deadline, call right before swapping buffers
+    void endFrame();
+    // call right after swapping buffers
+    void presented();
+    Stats stats();
+    void resetStats();
+    
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    Clock::duration m_period;
+    Clock::time_point m_deadline;
+    Clock::time_point m_frameStart;
+    Clock::time_point m_lastPresent;
+    bool m_presented;
+    unsigned int m_frame;
+    Stats m_totals;
+    unsigned int m_gpuFrames;
+    static constexpr unsigned int s_queryFrames = 3;
+    
+    // timestamps at the start and at the end of each frame
+    unsigned int m_queries[s_queryFrames][2];
+    bool m_queryPending[s_queryFrames];
+    
+    // sleeping is left this close to the deadline, the rest is spun
+    static constexpr float s_spinMargin = 2.0f;
+    
+    void readQueries(unsigned int slot);
+};
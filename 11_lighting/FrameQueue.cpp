@@ -0,0 +1,90 @@
+#include <chrono>
+#include "FrameQueue.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static unsigned long long microseconds(Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+FrameQueue::FrameQueue():
+    m_published(0),
+    m_released(0),
+    m_producerWait(0),
+    m_consumerWait(0),
+    m_frames(0),
+    m_producerWaiting(false),
+    m_consumerWaiting(false)
+{
+}
+
+FramePacket& FrameQueue::acquire() {
+    unsigned int published = m_published.load(std::memory_order_relaxed);
+    
+    if (published - m_released.load(std::memory_order_acquire) == s_capacity) {
+        Clock::time_point start = Clock::now();
+        
+        std::unique_lock<std::mutex> lock(m_mutex);
+        
+        m_producerWaiting = true;
+        m_wakeup.wait(lock, [&]() { return published - m_released.load() != s_capacity; });
+        m_producerWaiting = false;
+        
+        m_producerWait += microseconds(Clock::now() - start);
+    }
+    
+    return m_packets[published % s_capacity];
+}
+
+void FrameQueue::publish() {
+    m_published.fetch_add(1);
+    wake(m_consumerWaiting);
+}
+
+const FramePacket& FrameQueue::front() {
+    unsigned int released = m_released.load(std::memory_order_relaxed);
+    
+    if (m_published.load(std::memory_order_acquire) == released) {
+        Clock::time_point start = Clock::now();
+        
+        std::unique_lock<std::mutex> lock(m_mutex);
+        
+        m_consumerWaiting = true;
+        m_wakeup.wait(lock, [&]() { return m_published.load() != released; });
+        m_consumerWaiting = false;
+        
+        m_consumerWait += microseconds(Clock::now() - start);
+    }
+    
+    return m_packets[released % s_capacity];
+}
+
+void FrameQueue::release() {
+    m_released.fetch_add(1);
+    m_frames++;
+    wake(m_producerWaiting);
+}
+
+FrameQueue::Stats FrameQueue::stats() {
+    unsigned int frames = m_frames.load();
+    
+    if (frames == 0) return { 0, 0.0f, 0.0f };
+    
+    return { frames, m_producerWait.load() / 1000.0f / frames, m_consumerWait.load() / 1000.0f / frames };
+}
+
+void FrameQueue::wake(const std::atomic<bool>& waiting) {
+    // the index was advanced before this load and the waiter flags itself before checking the index, so either it
+    // sees the new index or it is seen here
+    if (!waiting) return;
+    
+    // the waiter holds the lock until it sleeps, so the notification can't slip in between
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wakeup.notify_one();
+}
+
+void FrameQueue::resetStats() {
+    m_frames = 0;
+    m_producerWait = 0;
+    m_consumerWait = 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Light.h"
+#include "InstanceBatch.h"
+
+// Everything the render thread needs of one simulated frame. Once published it is not written again until the
+// render thread hands it back.
+struct FramePacket {
+    // seconds, when the simulation sampled it
+    float time;
+    // framebuffer size
+    int width;
+    int height;
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPosition;
+    // of the orbiting light, also when there are no lights to shade with
+    glm::vec3 lightPosition;
+    std::vector<Light> lights;
+    std::vector<Instance> lightMarkers;
+    // the render thread stops at this packet instead of drawing it
+    bool last;
+};
+
+// Single producer, single consumer queue of frame packets from the simulation to the render thread. Packets live in a
+// fixed ring and are reused, so their vectors keep their capacity. Each side only ever advances its own index, so a
+// pair of atomics is all the synchronization a side needs while the other keeps up. A side that has to wait sleeps on a
+// condition variable instead of spinning, the render thread spends most of a vsynced frame in the swap. Two packets let
+// the simulation of the next frame overlap the rendering of this one without running further ahead.
+class FrameQueue {
+public:
+    // in milliseconds since the last reset, per frame rendered
+    struct Stats {
+        unsigned int frames;
+        float producerWait;
+        float consumerWait;
+    };
+    
+    FrameQueue();
+    // producer: a packet to fill, waits while the render thread still holds every one
+    FramePacket& acquire();
+    void publish();
+    // consumer: the oldest published packet, waits for one
+    const FramePacket& front();
+    void release();
+    Stats stats();
+    void resetStats();
+    
+private:
+    static constexpr unsigned int s_capacity = 2;
+    
+    FramePacket m_packets[s_capacity];
+    // packets published and released so far, the difference is how many the render thread has to go
+    std::atomic<unsigned int> m_published;
+    std::atomic<unsigned int> m_released;
+    // microseconds, written by one side and read by the reporting one
+    std::atomic<unsigned long long> m_producerWait;
+    std::atomic<unsigned long long> m_consumerWait;
+    std::atomic<unsigned int> m_frames;
+    // set by a side going to sleep, the other side only touches the mutex to wake it while it is
+    std::atomic<bool> m_producerWaiting;
+    std::atomic<bool> m_consumerWaiting;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    
+    void wake(const std::atomic<bool>& waiting);
+};
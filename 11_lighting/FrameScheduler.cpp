@@ -0,0 +1,55 @@
+#include <chrono>
+#include <algorithm>
+#include "FrameScheduler.h"
+
+FrameScheduler::FrameScheduler(unsigned int framesInFlight):
+    m_fences(std::max(framesInFlight, 1u), (GLsync)0),
+    m_frame(0),
+    m_totals()
+{
+}
+
+void FrameScheduler::beginFrame() {
+    // the slot still holds the fence of the frame framesInFlight ago
+    GLsync fence = m_fences[m_frame % m_fences.size()];
+    float waitTime = 0.0f;
+    
+    if (fence) {
+        auto start = std::chrono::steady_clock::now();
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        
+        while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED) {
+            flags = 0;
+        }
+        
+        glDeleteSync(fence);
+        m_fences[m_frame % m_fences.size()] = 0;
+        
+        waitTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    m_totals.frames++;
+    m_totals.waitTime += waitTime;
+    m_totals.maxWaitTime = std::max(m_totals.maxWaitTime, waitTime);
+}
+
+void FrameScheduler::endFrame() {
+    m_fences[m_frame % m_fences.size()] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_frame++;
+}
+
+unsigned int FrameScheduler::framesInFlight() {
+    return (unsigned int)m_fences.size();
+}
+
+FrameScheduler::Stats FrameScheduler::stats() {
+    Stats stats = m_totals;
+    
+    if (stats.frames > 0) stats.waitTime /= stats.frames;
+    
+    return stats;
+}
+
+void FrameScheduler::resetStats() {
+    m_totals = Stats();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+
+// Bounds how far the CPU runs ahead of the GPU. A fence goes in after every frame, and a frame starts only once the
+// frame that many before it has finished on the GPU, so input sampled at the start of a frame is at most that many
+// frames old when it reaches the screen. When a render thread waits here, input is sampled on another thread up to a
+// queued frame ahead of it and ends up one frame older. Time spent waiting is recorded: steady waits mean the GPU is
+// the bottleneck.
+class FrameScheduler {
+public:
+    // in milliseconds since the last reset
+    struct Stats {
+        unsigned int frames;
+        float waitTime;
+        float maxWaitTime;
+    };
+    
+    FrameScheduler(unsigned int framesInFlight);
+    // waits until fewer than framesInFlight frames are unfinished, call before sampling input or taking a queued frame
+    void beginFrame();
+    // fences the frame, call after swapping buffers
+    void endFrame();
+    unsigned int framesInFlight();
+    // mean wait per frame
+    Stats stats();
+    void resetStats();
+    
+private:
+    std::vector<GLsync> m_fences;
+    unsigned int m_frame;
+    Stats m_totals;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+class Frustum {
+public:
+    // left, right, bottom, top, near, far; normals point inside
+    glm::vec4 planes[6];
+    
+    Frustum(const glm::mat4& viewProjection);
+    bool intersects(const glm::vec3& center, float radius) const;
+};
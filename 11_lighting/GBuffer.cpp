@@ -0,0 +1,28 @@
+#include "GBuffer.h"
+#include "GLState.h"
+
+GBuffer::GBuffer():
+    albedo(FrameGraph::none),
+    normal(FrameGraph::none),
+    depth(FrameGraph::none)
+{
+}
+
+void GBuffer::create(FrameGraph::Builder& builder, int width, int height) {
+    albedo = builder.create("albedo", { width, height, GL_RGBA8 });
+    normal = builder.create("normal", { width, height, GL_RG16F });
+    depth = builder.create("depth", { width, height, GL_DEPTH_COMPONENT24 });
+}
+
+void GBuffer::read(FrameGraph::Builder& builder) {
+    builder.read(albedo);
+    builder.read(normal);
+    builder.read(depth);
+}
+
+void GBuffer::bindTextures(FrameGraph& graph) const {
+    // the lighting pass reads single texels, filtering never comes into it
+    GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, graph.texture(albedo));
+    GLState::bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, graph.texture(normal));
+    GLState::bindTexture(GL_TEXTURE2, GL_TEXTURE_2D, graph.texture(depth));
+}
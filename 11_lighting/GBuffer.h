@@ -0,0 +1,20 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "FrameGraph.h"
+
+// Geometry pass targets: albedo + specular strength (RGBA8), octahedral view space normal (RG16F) and depth (24 bit).
+// View space position is rebuilt from depth in the lighting pass instead of being stored. The targets are transients
+// of the frame graph, they only live from the geometry pass to the lighting pass.
+class GBuffer {
+public:
+    FrameGraph::Resource albedo;
+    FrameGraph::Resource normal;
+    FrameGraph::Resource depth;
+    
+    GBuffer();
+    // declares the targets for the geometry pass, which writes them in this order
+    void create(FrameGraph::Builder& builder, int width, int height);
+    void read(FrameGraph::Builder& builder);
+    void bindTextures(FrameGraph& graph) const;
+};
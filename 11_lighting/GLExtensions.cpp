@@ -0,0 +1,37 @@
+#include <iostream>
+#include "GLExtensions.h"
+
+PFNGLDISPATCHCOMPUTEPROC glad_glDispatchCompute = NULL;
+PFNGLMEMORYBARRIERPROC glad_glMemoryBarrier = NULL;
+PFNGLBINDIMAGETEXTUREPROC glad_glBindImageTexture = NULL;
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect = NULL;
+PFNGLBUFFERSTORAGEPROC glad_glBufferStorage = NULL;
+
+bool GLExtensions::gpuDriven = false;
+bool GLExtensions::bufferStorage = false;
+bool GLExtensions::conservativeQueries = false;
+
+static bool hasVersion(int major, int minor) {
+    return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+void GLExtensions::load(GLADloadproc load) {
+    if (hasVersion(4, 3)) {
+        glad_glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)load("glDispatchCompute");
+        glad_glMemoryBarrier = (PFNGLMEMORYBARRIERPROC)load("glMemoryBarrier");
+        glad_glBindImageTexture = (PFNGLBINDIMAGETEXTUREPROC)load("glBindImageTexture");
+        glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+    }
+    
+    if (hasVersion(4, 4)) {
+        glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+    }
+    
+    gpuDriven = glad_glDispatchCompute && glad_glMemoryBarrier && glad_glBindImageTexture && glad_glMultiDrawElementsIndirect;
+    bufferStorage = glad_glBufferStorage != NULL;
+    conservativeQueries = hasVersion(4, 3);
+    
+    std::cout << "[INFO] OpenGL " << GLVersion.major << "." << GLVersion.minor
+              << ", GPU driven rendering " << (gpuDriven ? "available" : "unavailable")
+              << ", persistent mapping " << (bufferStorage ? "available" : "unavailable") << std::endl;
+}
@@ -0,0 +1,203 @@
+#include "GLState.h"
+
+unsigned int GLState::s_program = GLState::s_unknown;
+unsigned int GLState::s_vao = GLState::s_unknown;
+GLenum GLState::s_activeTexture = GLState::s_unknown;
+unsigned int GLState::s_framebuffer = GLState::s_unknown;
+std::unordered_map<GLenum, unsigned int> GLState::s_buffers;
+std::unordered_map<uint64_t, GLState::Range> GLState::s_ranges;
+std::unordered_map<uint64_t, unsigned int> GLState::s_textures;
+int GLState::s_depthTest = -1;
+GLenum GLState::s_depthFunc = GLState::s_unknown;
+int GLState::s_depthMask = -1;
+int GLState::s_colorMask = -1;
+int GLState::s_blend = -1;
+GLenum GLState::s_blendSrc = GLState::s_unknown;
+GLenum GLState::s_blendDst = GLState::s_unknown;
+int GLState::s_cullFace = -1;
+GLenum GLState::s_cullMode = GLState::s_unknown;
+int GLState::s_depthClamp = -1;
+int GLState::s_scissorTest = -1;
+int GLState::s_clipDistances[GLState::s_clipPlanes] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+GLState::Stats GLState::s_stats = { 0, 0 };
+
+bool GLState::changed(bool differs) {
+    if (differs) {
+        s_stats.issued++;
+    } else {
+        s_stats.skipped++;
+    }
+    
+    return differs;
+}
+
+void GLState::useProgram(unsigned int program) {
+    if (!changed(s_program != program)) return;
+    
+    s_program = program;
+    glUseProgram(program);
+}
+
+void GLState::bindVertexArray(unsigned int vao) {
+    if (!changed(s_vao != vao)) return;
+    
+    // the element array binding is part of the VAO
+    s_vao = vao;
+    s_buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+    glBindVertexArray(vao);
+}
+
+void GLState::bindBuffer(GLenum target, unsigned int buffer) {
+    auto it = s_buffers.find(target);
+    
+    if (!changed(it == s_buffers.end() || it->second != buffer)) return;
+    
+    s_buffers[target] = buffer;
+    glBindBuffer(target, buffer);
+}
+
+void GLState::bindBufferBase(GLenum target, unsigned int index, unsigned int buffer) {
+    bindBufferRange(target, index, buffer, 0, 0);
+}
+
+void GLState::bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size) {
+    uint64_t key = ((uint64_t)target << 32) | index;
+    auto it = s_ranges.find(key);
+    
+    if (!changed(it == s_ranges.end() || it->second.buffer != buffer || it->second.offset != offset || it->second.size != size)) return;
+    
+    // indexed binds also replace the generic binding of the target
+    s_ranges[key] = { buffer, offset, size };
+    s_buffers[target] = buffer;
+    
+    if (size == 0) {
+        glBindBufferBase(target, index, buffer);
+    } else {
+        glBindBufferRange(target, index, buffer, offset, size);
+    }
+}
+
+void GLState::bindTexture(GLenum unit, GLenum target, unsigned int texture) {
+    uint64_t key = ((uint64_t)unit << 32) | target;
+    auto it = s_textures.find(key);
+    
+    if (!changed(it == s_textures.end() || it->second != texture)) return;
+    
+    if (s_activeTexture != unit) {
+        s_activeTexture = unit;
+        glActiveTexture(unit);
+    }
+    
+    s_textures[key] = texture;
+    glBindTexture(target, texture);
+}
+
+void GLState::bindFramebuffer(unsigned int framebuffer) {
+    if (!changed(s_framebuffer != framebuffer)) return;
+    
+    s_framebuffer = framebuffer;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void GLState::setCapability(GLenum capability, int& cached, bool enabled) {
+    if (!changed(cached != (int)enabled)) return;
+    
+    cached = enabled;
+    
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+}
+
+void GLState::setDepthTest(bool enabled) {
+    setCapability(GL_DEPTH_TEST, s_depthTest, enabled);
+}
+
+void GLState::setDepthFunc(GLenum func) {
+    if (!changed(s_depthFunc != func)) return;
+    
+    s_depthFunc = func;
+    glDepthFunc(func);
+}
+
+void GLState::setDepthMask(bool enabled) {
+    if (!changed(s_depthMask != (int)enabled)) return;
+    
+    s_depthMask = enabled;
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::setColorMask(bool enabled) {
+    if (!changed(s_colorMask != (int)enabled)) return;
+    
+    s_colorMask = enabled;
+    glColorMask(enabled ? GL_TRUE : GL_FALSE, enabled ? GL_TRUE : GL_FALSE, enabled ? GL_TRUE : GL_FALSE, enabled ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::setBlend(bool enabled) {
+    setCapability(GL_BLEND, s_blend, enabled);
+}
+
+void GLState::setBlendFunc(GLenum src, GLenum dst) {
+    if (!changed(s_blendSrc != src || s_blendDst != dst)) return;
+    
+    s_blendSrc = src;
+    s_blendDst = dst;
+    glBlendFunc(src, dst);
+}
+
+void GLState::setCullFace(bool enabled) {
+    setCapability(GL_CULL_FACE, s_cullFace, enabled);
+}
+
+void GLState::setCullMode(GLenum face) {
+    if (!changed(s_cullMode != face)) return;
+    
+    s_cullMode = face;
+    glCullFace(face);
+}
+
+void GLState::setDepthClamp(bool enabled) {
+    setCapability(GL_DEPTH_CLAMP, s_depthClamp, enabled);
+}
+
+void GLState::setScissorTest(bool enabled) {
+    setCapability(GL_SCISSOR_TEST, s_scissorTest, enabled);
+}
+
+void GLState::setClipDistance(unsigned int plane, bool enabled) {
+    setCapability(GL_CLIP_DISTANCE0 + plane, s_clipDistances[plane], enabled);
+}
+
+void GLState::invalidate() {
+    s_program = s_unknown;
+    s_vao = s_unknown;
+    s_activeTexture = s_unknown;
+    s_framebuffer = s_unknown;
+    s_buffers.clear();
+    s_ranges.clear();
+    s_textures.clear();
+    s_depthTest = -1;
+    s_depthFunc = s_unknown;
+    s_depthMask = -1;
+    s_colorMask = -1;
+    s_blend = -1;
+    s_blendSrc = s_unknown;
+    s_blendDst = s_unknown;
+    s_cullFace = -1;
+    s_cullMode = s_unknown;
+    s_depthClamp = -1;
+    s_scissorTest = -1;
+    
+    for (int& clipDistance : s_clipDistances) clipDistance = -1;
+}
+
+GLState::Stats GLState::stats() {
+    return s_stats;
+}
+
+void GLState::resetStats() {
+    s_stats = { 0, 0 };
+}
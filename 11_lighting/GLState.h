@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <glad/glad.h>
+
+// Shadow copy of the GL binding and fixed function state. Calls that would not change anything are
+// dropped before they reach the driver. Everything that binds must go through here or the copy goes stale.
+class GLState {
+public:
+    struct Stats {
+        unsigned int issued;
+        unsigned int skipped;
+    };
+    
+    static void useProgram(unsigned int program);
+    static void bindVertexArray(unsigned int vao);
+    static void bindBuffer(GLenum target, unsigned int buffer);
+    static void bindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+    static void bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, GLintptr offset, GLsizeiptr size);
+    static void bindTexture(GLenum unit, GLenum target, unsigned int texture);
+    static void bindFramebuffer(unsigned int framebuffer);
+    static void setDepthTest(bool enabled);
+    static void setDepthFunc(GLenum func);
+    static void setDepthMask(bool enabled);
+    static void setColorMask(bool enabled);
+    static void setBlend(bool enabled);
+    static void setBlendFunc(GLenum src, GLenum dst);
+    static void setCullFace(bool enabled);
+    static void setCullMode(GLenum face);
+    static void setDepthClamp(bool enabled);
+    static void setScissorTest(bool enabled);
+    static void setClipDistance(unsigned int plane, bool enabled);
+    
+    // forget everything, for code that changed state behind the cache's back
+    static void invalidate();
+    static Stats stats();
+    static void resetStats();
+    
+private:
+    struct Range {
+        unsigned int buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+    
+    static const unsigned int s_unknown = ~0u;
+    // GL guarantees at least 8 clip distances
+    static const unsigned int s_clipPlanes = 8;
+    
+    static unsigned int s_program;
+    static unsigned int s_vao;
+    static GLenum s_activeTexture;
+    static unsigned int s_framebuffer;
+    static std::unordered_map<GLenum, unsigned int> s_buffers;
+    static std::unordered_map<uint64_t, Range> s_ranges;
+    static std::unordered_map<uint64_t, unsigned int> s_textures;
+    static int s_depthTest;
+    static GLenum s_depthFunc;
+    static int s_depthMask;
+    static int s_colorMask;
+    static int s_blend;
+    static GLenum s_blendSrc;
+    static GLenum s_blendDst;
+    static int s_cullFace;
+    static GLenum s_cullMode;
+    static int s_depthClamp;
+    static int s_scissorTest;
+    static int s_clipDistances[s_clipPlanes];
+    static Stats s_stats;
+    
+    static bool changed(bool differs);
+    static void setCapability(GLenum capability, int& cached, bool enabled);
+};
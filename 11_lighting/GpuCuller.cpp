@@ -0,0 +1,161 @@
+#include "GpuCuller.h"
+#include "GLState.h"
+#include "Frustum.h"
+#include "LodSelector.h"
+
+GpuCuller::GpuCuller(Mesh& mesh):
+    m_mesh(mesh),
+    m_cullProgram("./shaders/cull-cs.glsl"),
+    m_instanceCount(0),
+    m_lodCount(mesh.lodCount()),
+    m_lodThreshold(1.0f),
+    m_viewPosition(0.0f),
+    m_pixelsPerUnit(0.0f)
+{
+    glGenBuffers(1, &m_instanceBuffer);
+    glGenBuffers(1, &m_visibleBuffer);
+    glGenBuffers(1, &m_commandBuffer);
+    glGenBuffers(1, &m_occludedBuffer);
+    glGenBuffers(1, &m_levelBuffer);
+    
+    glGenVertexArrays(1, &VAO);
+    GLState::bindVertexArray(VAO);
+    
+    m_mesh.setAttributes();
+    
+    // the visible buffer holds compacted instance indices, each command's baseInstance selects its range
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_visibleBuffer);
+    glVertexAttribIPointer(11, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+    glEnableVertexAttribArray(11);
+    glVertexAttribDivisor(11, 1);
+    
+    GLState::bindVertexArray(0);
+    
+    // one command per culling phase and level of detail
+    for (unsigned int phase = 0; phase < 2; phase++) {
+        for (unsigned int level = 0; level < m_lodCount; level++) {
+            m_commands.push_back({ m_mesh.lod(level).indexCount, 0, m_mesh.lod(level).firstIndex, 0, 0 });
+        }
+    }
+    
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DrawElementsIndirectCommand), m_commands.data(), GL_DYNAMIC_DRAW);
+}
+
+void GpuCuller::setInstances(const std::vector<Instance>& instances) {
+    m_instanceCount = (unsigned int)instances.size();
+    
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+    
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, m_visibleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_commands.size() * instances.size() * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+    
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, m_occludedBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+    
+    // everything starts at full detail
+    std::vector<unsigned int> levels(instances.size(), 0);
+    
+    GLState::bindBuffer(GL_SHADER_STORAGE_BUFFER, m_levelBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, levels.size() * sizeof(unsigned int), levels.data(), GL_DYNAMIC_COPY);
+    
+    for (unsigned int i = 0; i < m_commands.size(); i++) {
+        m_commands[i].baseInstance = i * m_instanceCount;
+    }
+}
+
+void GpuCuller::setLodThreshold(float threshold) {
+    m_lodThreshold = threshold;
+}
+
+void GpuCuller::cull(const glm::mat4& viewProjection, const glm::vec3& viewPosition, float pixelsPerUnit, HiZBuffer* hiZ) {
+    Frustum frustum(viewProjection);
+    
+    m_viewProjection = viewProjection;
+    m_viewPosition = viewPosition;
+    m_pixelsPerUnit = pixelsPerUnit;
+    
+    // instance counts are rebuilt from zero every frame by the atomics in the compute shader
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, m_commands.size() * sizeof(DrawElementsIndirectCommand), m_commands.data());
+    
+    m_cullProgram.use();
+    m_cullProgram.setValue("frustumPlanes", frustum.planes, 6);
+    
+    bool occlusion = hiZ && hiZ->valid();
+    
+    if (occlusion) hiZ->bindTexture();
+    
+    dispatch(0, occlusion);
+}
+
+void GpuCuller::draw() {
+    drawPhase(0);
+}
+
+void GpuCuller::cullOccluded(HiZBuffer& hiZ) {
+    hiZ.bindTexture();
+    dispatch(1, true);
+}
+
+void GpuCuller::drawOccluded() {
+    drawPhase(1);
+}
+
+GpuCuller::Stats GpuCuller::stats() {
+    std::vector<DrawElementsIndirectCommand> commands(m_commands.size());
+    
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+    glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+    
+    Stats stats = { 0, 0, 0 };
+    
+    for (unsigned int i = 0; i < commands.size(); i++) {
+        if (i < m_lodCount) {
+            stats.visible += commands[i].instanceCount;
+        } else {
+            stats.disoccluded += commands[i].instanceCount;
+        }
+        
+        stats.triangles += commands[i].instanceCount * commands[i].count / 3;
+    }
+    
+    return stats;
+}
+
+void GpuCuller::dispatch(int phase, bool occlusion) {
+    m_cullProgram.use();
+    m_cullProgram.setValue("boundingSphere", m_mesh.boundingSphere());
+    m_cullProgram.setValue("instanceCount", (int)m_instanceCount);
+    m_cullProgram.setValue("phase", phase);
+    m_cullProgram.setValue("occlusion", (int)occlusion);
+    m_cullProgram.setValue("viewProjection", m_viewProjection);
+    m_cullProgram.setValue("hiZ", HiZBuffer::unit);
+    
+    glm::vec4 lodErrors(0.0f);
+    for (unsigned int i = 0; i < m_lodCount; i++) lodErrors[i] = m_mesh.lod(i).error;
+    
+    m_cullProgram.setValue("lodCount", (int)m_lodCount);
+    m_cullProgram.setValue("maxLevel", m_lodThreshold > 0.0f ? (int)m_lodCount - 1 : 0);
+    m_cullProgram.setValue("lodErrors", lodErrors);
+    m_cullProgram.setValue("lodHysteresis", LodSelector::hysteresis);
+    m_cullProgram.setValue("viewPosition", m_viewPosition);
+    m_cullProgram.setValue("lodScale", m_lodThreshold > 0.0f ? m_pixelsPerUnit / m_lodThreshold : 0.0f);
+    
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_instanceBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_visibleBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_commandBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_occludedBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_levelBuffer);
+    
+    glDispatchCompute((m_instanceCount + s_groupSize - 1) / s_groupSize, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void GpuCuller::drawPhase(int phase) {
+    GLState::bindVertexArray(VAO);
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_instanceBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, m_mesh.indexType(), (void*)(phase * m_lodCount * sizeof(DrawElementsIndirectCommand)), m_lodCount, 0);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include "GLExtensions.h"
+#include "Shader.h"
+#include "Mesh.h"
+#include "InstanceBatch.h"
+#include "HiZBuffer.h"
+
+// Culls instances against the frustum in a compute shader and draws the survivors with
+// glMultiDrawElementsIndirect, without the CPU ever touching per-instance data after setInstances().
+// With a depth pyramid culling runs in two phases. cull() also rejects instances hidden in the pyramid of the
+// previous frame, then after draw() the pyramid is built from this frame's depth and cullOccluded() gives the
+// rejected ones a second chance, so what the camera uncovered is drawn by drawOccluded() without a frame of delay.
+// Every level of detail of the mesh has its own command per phase. The shader picks the level of each instance the
+// way LodSelector does and keeps it in a buffer for the hysteresis of the next frame.
+class GpuCuller {
+public:
+    unsigned int VAO;
+    
+    struct Stats {
+        unsigned int visible;
+        // rejected by the previous pyramid, visible in this frame's
+        unsigned int disoccluded;
+        unsigned int triangles;
+    };
+    
+    GpuCuller(Mesh& mesh);
+    void setInstances(const std::vector<Instance>& instances);
+    // in pixels as for LodSelector, 0 keeps everything at full detail
+    void setLodThreshold(float threshold);
+    void cull(const glm::mat4& viewProjection, const glm::vec3& viewPosition, float pixelsPerUnit, HiZBuffer* hiZ = NULL);
+    void draw();
+    void cullOccluded(HiZBuffer& hiZ);
+    void drawOccluded();
+    // reads the counts back from the GPU, waits for the culling to finish
+    Stats stats();
+    
+private:
+    Mesh& m_mesh;
+    Shader m_cullProgram;
+    unsigned int m_instanceBuffer;
+    unsigned int m_visibleBuffer;
+    unsigned int m_commandBuffer;
+    unsigned int m_occludedBuffer;
+    unsigned int m_levelBuffer;
+    unsigned int m_instanceCount;
+    unsigned int m_lodCount;
+    float m_lodThreshold;
+    // phase major, a command per level
+    std::vector<DrawElementsIndirectCommand> m_commands;
+    glm::mat4 m_viewProjection;
+    glm::vec3 m_viewPosition;
+    float m_pixelsPerUnit;
+    
+    void dispatch(int phase, bool occlusion);
+    void drawPhase(int phase);
+    
+    static constexpr unsigned int s_groupSize = 64;
+};
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include "HiZBuffer.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+
+HiZBuffer::HiZBuffer():
+    m_program("./shaders/hiz-cs.glsl"),
+    m_width(0),
+    m_height(0),
+    m_levels(0),
+    m_valid(false)
+{
+    glGenTextures(1, &m_depth);
+    glGenTextures(1, &m_pyramid);
+    
+    m_program.use();
+    m_program.setValue("source", unit);
+}
+
+void HiZBuffer::build(int width, int height) {
+    if (width != m_width || height != m_height) allocate(width, height);
+    
+    GLState::bindTexture(GL_TEXTURE0 + unit, GL_TEXTURE_2D, m_depth);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, m_width, m_height);
+    
+    m_program.use();
+    
+    // level 0 copies the depth texels one to one, the rest reduce the level below in 2x2 blocks
+    for (int level = 0; level < m_levels; level++) {
+        int levelWidth = std::max(m_width >> level, 1);
+        int levelHeight = std::max(m_height >> level, 1);
+        
+        GLState::bindTexture(GL_TEXTURE0 + unit, GL_TEXTURE_2D, level == 0 ? m_depth : m_pyramid);
+        m_program.setValue("sourceLevel", std::max(level - 1, 0));
+        m_program.setValue("scale", level == 0 ? 1 : 2);
+        
+        glBindImageTexture(0, m_pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((levelWidth + s_groupSize - 1) / s_groupSize, (levelHeight + s_groupSize - 1) / s_groupSize, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+    
+    m_valid = true;
+}
+
+void HiZBuffer::bindTexture() {
+    GLState::bindTexture(GL_TEXTURE0 + unit, GL_TEXTURE_2D, m_pyramid);
+}
+
+bool HiZBuffer::valid() {
+    return m_valid;
+}
+
+void HiZBuffer::allocate(int width, int height) {
+    m_width = width;
+    m_height = height;
+    m_levels = 1;
+    
+    while ((std::max(m_width, m_height) >> m_levels) > 0) m_levels++;
+    
+    GLState::bindTexture(GL_TEXTURE0 + unit, GL_TEXTURE_2D, m_depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_width, m_height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    
+    // read with texelFetch only, the filter just has to make the mip chain complete
+    GLState::bindTexture(GL_TEXTURE0 + unit, GL_TEXTURE_2D, m_pyramid);
+    
+    for (int level = 0; level < m_levels; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, std::max(m_width >> level, 1), std::max(m_height >> level, 1), 0, GL_RED, GL_FLOAT, NULL);
+    }
+    
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_levels - 1);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "Shader.h"
+
+// Depth pyramid for occlusion culling. Level 0 is a copy of the depth buffer, every level above keeps the farthest
+// depth of the texels it covers, so a bound whose nearest depth lies behind the pyramid texels under it is hidden.
+// Odd sizes fold their last row and column into the last texel of the next level instead of dropping them.
+class HiZBuffer {
+public:
+    static constexpr int unit = 8;
+    
+    HiZBuffer();
+    // rebuilds the pyramid from the depth of the bound framebuffer, which has to be width x height
+    void build(int width, int height);
+    void bindTexture();
+    // false until the first build
+    bool valid();
+    
+private:
+    Shader m_program;
+    unsigned int m_depth;
+    unsigned int m_pyramid;
+    int m_width;
+    int m_height;
+    int m_levels;
+    bool m_valid;
+    
+    static constexpr unsigned int s_groupSize = 8;
+    
+    void allocate(int width, int height);
+};
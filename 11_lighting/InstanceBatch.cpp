@@ -0,0 +1,68 @@
+#include <cstddef>
+#include "InstanceBatch.h"
+#include "GLState.h"
+
+Instance::Instance() {}
+
+Instance::Instance(const glm::mat4& model, const glm::vec3& color):
+    model(model),
+    color(color, 1.0f)
+{
+    glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(model)));
+    
+    for (int i = 0; i < 3; i++) normalMatrix[i] = glm::vec4(normal[i], 0.0f);
+}
+
+InstanceBatch::InstanceBatch(Mesh& mesh):
+    m_mesh(mesh),
+    m_size(0),
+    m_capacity(0)
+{
+    glGenVertexArrays(1, &VAO);
+    GLState::bindVertexArray(VAO);
+    
+    m_mesh.setAttributes();
+    
+    glGenBuffers(1, &m_instanceVBO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+    
+    for (unsigned int i = 0; i < 4; i++) {
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offsetof(Instance, model) + i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribDivisor(3 + i, 1);
+    }
+    
+    for (unsigned int i = 0; i < 3; i++) {
+        glVertexAttribPointer(7 + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offsetof(Instance, normalMatrix) + i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(7 + i);
+        glVertexAttribDivisor(7 + i, 1);
+    }
+    
+    glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, color));
+    glEnableVertexAttribArray(10);
+    glVertexAttribDivisor(10, 1);
+    
+    GLState::bindVertexArray(0);
+}
+
+void InstanceBatch::update(const std::vector<Instance>& instances) {
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+    
+    if (instances.size() > m_capacity) {
+        m_capacity = (unsigned int)instances.size();
+        glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(Instance), instances.data(), GL_DYNAMIC_DRAW);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(Instance), instances.data());
+    }
+    
+    m_size = (unsigned int)instances.size();
+}
+
+void InstanceBatch::draw() {
+    GLState::bindVertexArray(VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, m_mesh.indexCount(), m_mesh.indexType(), (void*)0, m_size);
+}
+
+unsigned int InstanceBatch::size() {
+    return m_size;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+
+struct Instance {
+    glm::mat4 model;
+    // columns of the world space normal matrix padded to vec4, read as mat3x4 in the shader
+    glm::vec4 normalMatrix[3];
+    glm::vec4 color;
+    
+    Instance();
+    Instance(const glm::mat4& model, const glm::vec3& color);
+};
+
+class InstanceBatch {
+public:
+    unsigned int VAO;
+    
+    InstanceBatch(Mesh& mesh);
+    void update(const std::vector<Instance>& instances);
+    void draw();
+    unsigned int size();
+    
+private:
+    Mesh& m_mesh;
+    unsigned int m_instanceVBO;
+    unsigned int m_size;
+    unsigned int m_capacity;
+};
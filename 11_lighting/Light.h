@@ -0,0 +1,13 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Point light with a finite range, nothing is lit past radius. The first 32 bytes are read as two vec4 attributes
+struct Light {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+    float intensity;
+    // slot in ShadowMaps, -1 when the light casts no shadows
+    int shadowMap;
+};
@@ -0,0 +1,171 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "LightGrid.h"
+
+LightGrid::LightGrid():
+    m_lights(NULL),
+    m_origin(0.0f),
+    m_cellSize(1.0f),
+    m_size(0),
+    m_query(0)
+{}
+
+void LightGrid::build(const std::vector<Light>& lights) {
+    m_lights = &lights;
+    m_globalLights.clear();
+    m_indices.clear();
+    m_stamps.assign(lights.size(), 0);
+    m_query = 0;
+    
+    if (lights.empty()) {
+        m_size = glm::ivec3(0);
+        m_offsets.assign(1, 0);
+        return;
+    }
+    
+    float radiusSum = 0.0f;
+    
+    for (const Light& light : lights) radiusSum += light.radius;
+    
+    m_cellSize = 2.0f * radiusSum / lights.size();
+    
+    glm::vec3 lower(std::numeric_limits<float>::max());
+    glm::vec3 upper(-std::numeric_limits<float>::max());
+    std::vector<unsigned int> local;
+    
+    for (unsigned int i = 0; i < lights.size(); i++) {
+        const Light& light = lights[i];
+        
+        if (light.radius > s_globalScale * m_cellSize) {
+            m_globalLights.push_back(i);
+            continue;
+        }
+        
+        local.push_back(i);
+        lower = glm::min(lower, light.position - light.radius);
+        upper = glm::max(upper, light.position + light.radius);
+    }
+    
+    if (local.empty()) {
+        m_size = glm::ivec3(0);
+        m_offsets.assign(1, 0);
+        return;
+    }
+    
+    // bound the cell count, a sparse scene gets coarser cells rather than a huge grid
+    glm::vec3 extent = upper - lower;
+    float largest = std::max(extent.x, std::max(extent.y, extent.z));
+    
+    m_cellSize = std::max(m_cellSize, largest / s_maxCells);
+    m_origin = lower;
+    m_size = glm::clamp(glm::ivec3(extent / m_cellSize) + 1, glm::ivec3(1), glm::ivec3(s_maxCells));
+    
+    // counting sort of light references into cells
+    m_offsets.assign(m_size.x * m_size.y * m_size.z + 1, 0);
+    
+    for (int pass = 0; pass < 2; pass++) {
+        for (unsigned int i : local) {
+            const Light& light = lights[i];
+            glm::ivec3 first = cell(light.position - light.radius);
+            glm::ivec3 last = cell(light.position + light.radius);
+            
+            for (int z = first.z; z <= last.z; z++) {
+                for (int y = first.y; y <= last.y; y++) {
+                    for (int x = first.x; x <= last.x; x++) {
+                        unsigned int c = cellIndex(x, y, z);
+                        
+                        if (pass == 0) {
+                            m_offsets[c + 1]++;
+                        } else {
+                            m_indices[m_offsets[c]++] = i;
+                        }
+                    }
+                }
+            }
+        }
+        
+        if (pass == 0) {
+            for (unsigned int c = 1; c < m_offsets.size(); c++) m_offsets[c] += m_offsets[c - 1];
+            
+            m_indices.resize(m_offsets.back());
+        } else {
+            // the fill advanced every offset to the start of the next cell, shift them back
+            for (unsigned int c = (unsigned int)m_offsets.size() - 1; c > 0; c--) m_offsets[c] = m_offsets[c - 1];
+            
+            m_offsets[0] = 0;
+        }
+    }
+}
+
+unsigned int LightGrid::select(const glm::vec3& center, float radius, Light* selected, unsigned int maxCount) {
+    if (m_lights == NULL || maxCount == 0) return 0;
+    
+    unsigned int count = 0;
+    float influences[64];
+    
+    maxCount = std::min(maxCount, 64u);
+    m_query++;
+    
+    for (unsigned int light : m_globalLights) {
+        score(light, center, radius, selected, influences, count, maxCount);
+    }
+    
+    if (m_size.x == 0) return count;
+    
+    glm::ivec3 first = cell(center - radius);
+    glm::ivec3 last = cell(center + radius);
+    
+    for (int z = first.z; z <= last.z; z++) {
+        for (int y = first.y; y <= last.y; y++) {
+            for (int x = first.x; x <= last.x; x++) {
+                unsigned int c = cellIndex(x, y, z);
+                
+                for (unsigned int i = m_offsets[c]; i < m_offsets[c + 1]; i++) {
+                    score(m_indices[i], center, radius, selected, influences, count, maxCount);
+                }
+            }
+        }
+    }
+    
+    return count;
+}
+
+glm::ivec3 LightGrid::cell(const glm::vec3& position) {
+    return glm::clamp(glm::ivec3(glm::floor((position - m_origin) / m_cellSize)), glm::ivec3(0), m_size - 1);
+}
+
+unsigned int LightGrid::cellIndex(int x, int y, int z) {
+    return x + m_size.x * (y + m_size.y * z);
+}
+
+void LightGrid::score(unsigned int index, const glm::vec3& center, float radius, Light* selected, float* influences, unsigned int& count, unsigned int maxCount) {
+    if (m_stamps[index] == m_query) return;
+    
+    m_stamps[index] = m_query;
+    
+    const Light& light = (*m_lights)[index];
+    
+    // the light's own falloff at the point of the bounding sphere closest to it
+    float distance = std::max(glm::length(light.position - center) - radius, 0.0f);
+    
+    if (distance >= light.radius) return;
+    
+    float falloff = 1.0f - std::pow(distance / light.radius, 4.0f);
+    float brightness = std::max(light.color.r, std::max(light.color.g, light.color.b)) * light.intensity;
+    float influence = falloff * falloff * brightness;
+    
+    if (count == maxCount && influence <= influences[count - 1]) return;
+    
+    // insertion into the short list, dropping the weakest when it is full
+    unsigned int slot = count < maxCount ? count++ : count - 1;
+    
+    while (slot > 0 && influences[slot - 1] < influence) {
+        influences[slot] = influences[slot - 1];
+        selected[slot] = selected[slot - 1];
+        slot--;
+    }
+    
+    influences[slot] = influence;
+    selected[slot] = light;
+}
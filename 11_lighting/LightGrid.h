@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Light.h"
+
+// Uniform grid over the lights of a frame, rebuilt every frame, for finding the lights that reach a bounding sphere.
+// Cells are about two average radii wide; lights much larger than a cell skip the grid and are tested for every query.
+class LightGrid {
+public:
+    LightGrid();
+    void build(const std::vector<Light>& lights);
+    // copies the strongest lights reaching the sphere into selected, strongest first, and returns how many
+    unsigned int select(const glm::vec3& center, float radius, Light* selected, unsigned int maxCount);
+    
+private:
+    const std::vector<Light>* m_lights;
+    glm::vec3 m_origin;
+    float m_cellSize;
+    glm::ivec3 m_size;
+    // cell c holds m_indices[m_offsets[c]] up to m_offsets[c + 1]
+    std::vector<unsigned int> m_offsets;
+    std::vector<unsigned int> m_indices;
+    std::vector<unsigned int> m_globalLights;
+    // last query that visited each light, so lights spanning several cells are scored once
+    std::vector<unsigned int> m_stamps;
+    unsigned int m_query;
+    
+    static constexpr int s_maxCells = 64;
+    static constexpr float s_globalScale = 4.0f;
+    
+    glm::ivec3 cell(const glm::vec3& position);
+    unsigned int cellIndex(int x, int y, int z);
+    void score(unsigned int index, const glm::vec3& center, float radius, Light* selected, float* influences, unsigned int& count, unsigned int maxCount);
+};
@@ -0,0 +1,44 @@
+#include <algorithm>
+#include "LodSelector.h"
+
+LodSelector::LodSelector(unsigned int count, float threshold):
+    m_threshold(threshold),
+    m_viewPosition(0.0f),
+    m_pixelsPerUnit(0.0f),
+    m_stats()
+{
+    m_levels.resize(count, 0);
+}
+
+void LodSelector::beginFrame(const glm::vec3& viewPosition, float pixelsPerUnit) {
+    m_viewPosition = viewPosition;
+    m_pixelsPerUnit = pixelsPerUnit;
+    m_stats = Stats();
+}
+
+unsigned int LodSelector::select(unsigned int object, Mesh& mesh, const glm::vec4& bounds, float scale) {
+    unsigned int level = std::min((unsigned int)m_levels[object], mesh.lodCount() - 1);
+    
+    if (m_threshold > 0.0f) {
+        // the nearest point of the bounds is where the error shows the most
+        float distance = std::max(glm::length(glm::vec3(bounds) - m_viewPosition) - bounds.w, 1e-4f);
+        float pixels = scale * m_pixelsPerUnit / (distance * m_threshold);
+        
+        while (level > 0 && mesh.lod(level).error * pixels > 1.0f) level--;
+        while (level + 1 < mesh.lodCount() && mesh.lod(level + 1).error * pixels < hysteresis) level++;
+    } else {
+        level = 0;
+    }
+    
+    m_levels[object] = (unsigned char)level;
+    
+    m_stats.triangles += mesh.lod(level).indexCount / 3;
+    m_stats.fullTriangles += mesh.indexCount() / 3;
+    m_stats.objects[level]++;
+    
+    return level;
+}
+
+LodSelector::Stats LodSelector::stats() {
+    return m_stats;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+
+// Picks the level of detail of every object from how large the error of each level projects on screen: the coarsest
+// level whose error stays under the threshold in pixels. Distance rather than view depth decides, so turning the
+// camera never switches levels. An object only takes a coarser level once its error is well under the threshold and
+// goes back once the error of its current one is over it, so objects around a switching distance do not flicker.
+class LodSelector {
+public:
+    struct Stats {
+        unsigned int triangles;
+        // what the same objects would have drawn at full detail
+        unsigned int fullTriangles;
+        unsigned int objects[Mesh::maxLods];
+    };
+    
+    // a threshold of 0 keeps everything at full detail
+    LodSelector(unsigned int count, float threshold = 1.0f);
+    // pixelsPerUnit is how many pixels a unit long line facing the camera covers at distance 1
+    void beginFrame(const glm::vec3& viewPosition, float pixelsPerUnit);
+    // bounds is the world space bounding sphere of the object and scale the largest scale of its model
+    unsigned int select(unsigned int object, Mesh& mesh, const glm::vec4& bounds, float scale);
+    Stats stats();
+    
+    // a coarser level is taken once its error is under this share of the threshold
+    static constexpr float hysteresis = 0.7f;
+    
+private:
+    std::vector<unsigned char> m_levels;
+    float m_threshold;
+    glm::vec3 m_viewPosition;
+    float m_pixelsPerUnit;
+    Stats m_stats;
+};
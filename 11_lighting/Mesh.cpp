@@ -0,0 +1,236 @@
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+#include <unordered_map>
+#include "Mesh.h"
+#include "GLState.h"
+#include "MeshOptimizer.h"
+
+namespace {
+    struct VertexKey {
+        Mesh::Vertex vertex;
+        
+        bool operator==(const VertexKey& other) const {
+            return memcmp(&vertex, &other.vertex, sizeof(Mesh::Vertex)) == 0;
+        }
+    };
+    
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey& key) const {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key.vertex);
+            size_t hash = 14695981039346656037ull;
+            
+            for (size_t i = 0; i < sizeof(Mesh::Vertex); i++) {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+            
+            return hash;
+        }
+    };
+}
+
+Mesh::Mesh(const float* vertices, unsigned int vertexCount, VertexFormat format):
+    m_format(format)
+{
+    deduplicate(vertices, vertexCount);
+    optimize();
+    buildLods();
+    upload();
+    report();
+}
+
+void Mesh::draw(unsigned int lod) {
+    GLState::bindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, (GLsizei)m_lods[lod].indexCount, m_indexType, indexOffset(lod));
+}
+
+void Mesh::setAttributes() {
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+    m_format.setAttributes();
+}
+
+unsigned int Mesh::indexCount() {
+    return m_lods[0].indexCount;
+}
+
+GLenum Mesh::indexType() {
+    return m_indexType;
+}
+
+void* Mesh::indexOffset(unsigned int lod) {
+    size_t indexSize = m_indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    
+    return (void*)(m_lods[lod].firstIndex * indexSize);
+}
+
+glm::vec4 Mesh::boundingSphere() {
+    glm::vec3 min(INFINITY), max(-INFINITY);
+    
+    for (const Vertex& v : m_vertices) {
+        min = glm::min(min, v.position);
+        max = glm::max(max, v.position);
+    }
+    
+    glm::vec3 center = 0.5f * (min + max);
+    float radius = 0.0f;
+    
+    for (const Vertex& v : m_vertices) {
+        radius = glm::max(radius, glm::length(v.position - center));
+    }
+    
+    return glm::vec4(center, radius);
+}
+
+unsigned int Mesh::vertexCount() {
+    return (unsigned int)m_vertices.size();
+}
+
+unsigned int Mesh::lodCount() {
+    return (unsigned int)m_lods.size();
+}
+
+const Mesh::Lod& Mesh::lod(unsigned int index) {
+    return m_lods[index];
+}
+
+void Mesh::deduplicate(const float* vertices, unsigned int vertexCount) {
+    std::unordered_map<VertexKey, unsigned int, VertexKeyHash> unique;
+    
+    m_indices.reserve(vertexCount);
+    
+    for (unsigned int i = 0; i < vertexCount; i++) {
+        const float* src = vertices + i * 8;
+        VertexKey key;
+        
+        key.vertex.position = glm::vec3(src[0], src[1], src[2]);
+        key.vertex.normal = glm::vec3(src[3], src[4], src[5]);
+        key.vertex.texCoords = glm::vec2(src[6], src[7]);
+        
+        auto it = unique.find(key);
+        
+        if (it == unique.end()) {
+            it = unique.emplace(key, (unsigned int)m_vertices.size()).first;
+            m_vertices.push_back(key.vertex);
+        }
+        
+        m_indices.push_back(it->second);
+    }
+}
+
+void Mesh::optimize() {
+    unsigned int count = (unsigned int)m_vertices.size();
+    float acmrBefore = calculateACMR(m_indices, count, s_cacheSize);
+    
+    std::vector<glm::vec3> positions(count);
+    for (unsigned int i = 0; i < count; i++) positions[i] = m_vertices[i].position;
+    
+    std::vector<unsigned int> clusters;
+    m_indices = optimizeVertexCache(m_indices, count, s_cacheSize, clusters);
+    m_indices = optimizeOverdraw(m_indices, positions, clusters, s_cacheSize, 1.05f);
+    
+    std::vector<unsigned int> order = optimizeVertexFetch(m_indices, count);
+    std::vector<Vertex> vertices(order.size());
+    for (unsigned int i = 0; i < order.size(); i++) vertices[i] = m_vertices[order[i]];
+    m_vertices.swap(vertices);
+    
+    m_acmr = calculateACMR(m_indices, (unsigned int)m_vertices.size(), s_cacheSize);
+    
+    std::cout << "[INFO] Mesh: " << m_vertices.size() << " vertices, " << m_indices.size() / 3 << " triangles, ACMR "
+              << acmrBefore << " -> " << m_acmr << " (cache size " << s_cacheSize << ")" << std::endl;
+}
+
+void Mesh::buildLods() {
+    std::vector<glm::vec3> positions(m_vertices.size());
+    for (unsigned int i = 0; i < m_vertices.size(); i++) positions[i] = m_vertices[i].position;
+    
+    std::vector<unsigned int> indices(m_indices);
+    
+    m_lods.push_back({ 0, (unsigned int)m_indices.size(), 0.0f });
+    
+    // every level simplifies the one before, errors add up along the chain
+    while (m_lods.size() < maxLods) {
+        unsigned int target = (unsigned int)(indices.size() / 3 * s_lodReduction) * 3;
+        float error = 0.0f;
+        std::vector<unsigned int> simplified = simplifyMesh(indices, positions, target, error);
+        
+        if (simplified.size() > indices.size() * s_minLodReduction) break;
+        
+        std::vector<unsigned int> clusters;
+        indices = optimizeVertexCache(simplified, (unsigned int)positions.size(), s_cacheSize, clusters);
+        
+        m_lods.push_back({ (unsigned int)m_indices.size(), (unsigned int)indices.size(), m_lods.back().error + error });
+        m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+    }
+    
+    if (m_lods.size() > 1) {
+        std::cout << "[INFO] Mesh: " << m_lods.size() << " levels of detail,";
+        
+        for (const Lod& lod : m_lods) std::cout << " " << lod.indexCount / 3;
+        
+        std::cout << " triangles, coarsest error " << m_lods.back().error << std::endl;
+    }
+}
+
+void Mesh::upload() {
+    unsigned int stride = m_format.stride();
+    std::vector<unsigned char> vertexData(m_vertices.size() * stride);
+    
+    for (unsigned int i = 0; i < m_vertices.size(); i++) {
+        const Vertex& v = m_vertices[i];
+        m_format.write(&vertexData[i * stride], v.position, v.normal, v.texCoords);
+    }
+    
+    glGenVertexArrays(1, &VAO);
+    GLState::bindVertexArray(VAO);
+    
+    glGenBuffers(1, &m_VBO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+    
+    glGenBuffers(1, &m_EBO);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+    
+    if (m_vertices.size() <= 0xffff) {
+        std::vector<unsigned short> shortIndices(m_indices.begin(), m_indices.end());
+        
+        m_indexType = GL_UNSIGNED_SHORT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+    } else {
+        m_indexType = GL_UNSIGNED_INT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int), m_indices.data(), GL_STATIC_DRAW);
+    }
+    
+    m_format.setAttributes();
+    
+    // depth passes fetch positions only
+    unsigned int positionSize = m_format.positionSize();
+    std::vector<unsigned char> positionData(m_vertices.size() * positionSize);
+    
+    for (unsigned int i = 0; i < m_vertices.size(); i++) {
+        m_format.writePosition(&positionData[i * positionSize], m_vertices[i].position);
+    }
+    
+    glGenVertexArrays(1, &depthVAO);
+    GLState::bindVertexArray(depthVAO);
+    
+    glGenBuffers(1, &m_positionVBO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, positionData.size(), positionData.data(), GL_STATIC_DRAW);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+    
+    m_format.setPositionAttributes();
+    
+    GLState::bindVertexArray(0);
+}
+
+void Mesh::report() {
+    unsigned int standardStride = VertexFormat::standard().stride();
+    unsigned int stride = m_format.stride();
+    float fetchedVertices = m_acmr * m_lods[0].indexCount / 3;
+    
+    std::cout << "[INFO] Mesh: " << stride << " bytes per vertex (standard " << standardStride << "), vertex buffer "
+              << m_vertices.size() * stride << " bytes (standard " << m_vertices.size() * standardStride << "), fetched per draw "
+              << fetchedVertices * stride << " bytes (standard " << fetchedVertices * standardStride << ")" << std::endl;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "VertexFormat.h"
+
+class Mesh {
+public:
+    struct Vertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texCoords;
+    };
+    
+    // a simplified version of the mesh in the shared index buffer
+    struct Lod {
+        unsigned int firstIndex;
+        unsigned int indexCount;
+        // how far the surface strays from the full mesh, in mesh units
+        float error;
+    };
+    
+    static constexpr unsigned int maxLods = 4;
+    
+    unsigned int VAO;
+    // positions only, same index buffer, for depth passes
+    unsigned int depthVAO;
+    
+    Mesh(const float* vertices, unsigned int vertexCount, VertexFormat format = VertexFormat::standard());
+    void draw(unsigned int lod = 0);
+    void setAttributes();
+    // of the full detail level
+    unsigned int indexCount();
+    GLenum indexType();
+    // byte offset of a level in the index buffer, as glDrawElements takes it
+    void* indexOffset(unsigned int lod);
+    glm::vec4 boundingSphere();
+    unsigned int vertexCount();
+    unsigned int lodCount();
+    const Lod& lod(unsigned int index);
+    
+private:
+    std::vector<Vertex> m_vertices;
+    // every level, the full one first
+    std::vector<unsigned int> m_indices;
+    std::vector<Lod> m_lods;
+    VertexFormat m_format;
+    GLenum m_indexType;
+    float m_acmr;
+    unsigned int m_VBO;
+    unsigned int m_positionVBO;
+    unsigned int m_EBO;
+    
+    static constexpr unsigned int s_cacheSize = 16;
+    // each level aims for this share of the triangles of the one before and is dropped when it saves less than the second
+    static constexpr float s_lodReduction = 0.5f;
+    static constexpr float s_minLodReduction = 0.8f;
+    
+    void deduplicate(const float* vertices, unsigned int vertexCount);
+    void optimize();
+    void buildLods();
+    void upload();
+    void report();
+};
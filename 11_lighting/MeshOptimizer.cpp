@@ -0,0 +1,470 @@
+#include <algorithm>
+#include <cmath>
+#include "MeshOptimizer.h"
+
+static unsigned int simulateCache(unsigned int index, std::vector<unsigned int>& timestamps, unsigned int& time, unsigned int cacheSize) {
+    if (time - timestamps[index] > cacheSize) {
+        timestamps[index] = time++;
+        return 1;
+    }
+    
+    return 0;
+}
+
+float calculateACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize) {
+    if (indices.empty()) return 0.0f;
+    
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    unsigned int misses = 0;
+    
+    for (unsigned int index : indices) {
+        misses += simulateCache(index, timestamps, time, cacheSize);
+    }
+    
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+static int skipDeadEnd(const std::vector<unsigned int>& liveCount, std::vector<unsigned int>& deadEnd, unsigned int& cursor) {
+    while (!deadEnd.empty()) {
+        unsigned int vertex = deadEnd.back();
+        deadEnd.pop_back();
+        
+        if (liveCount[vertex] > 0) return vertex;
+    }
+    
+    while (cursor < liveCount.size()) {
+        if (liveCount[cursor] > 0) return cursor;
+        cursor++;
+    }
+    
+    return -1;
+}
+
+std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize, std::vector<unsigned int>& clusters) {
+    unsigned int triangleCount = (unsigned int)indices.size() / 3;
+    
+    std::vector<unsigned int> liveCount(vertexCount, 0);
+    for (unsigned int index : indices) liveCount[index]++;
+    
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + liveCount[v];
+    
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (unsigned int i = 0; i < indices.size(); i++) adjacency[fill[indices[i]]++] = i / 3;
+    
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    deadEnd.reserve(indices.size());
+    
+    clusters.clear();
+    
+    unsigned int time = cacheSize + 1;
+    unsigned int cursor = 0;
+    int fanning = skipDeadEnd(liveCount, deadEnd, cursor);
+    
+    if (fanning >= 0) clusters.push_back(0);
+    
+    while (fanning >= 0) {
+        candidates.clear();
+        
+        for (unsigned int i = offsets[fanning]; i < offsets[fanning + 1]; i++) {
+            unsigned int triangle = adjacency[i];
+            
+            if (emitted[triangle]) continue;
+            
+            for (unsigned int k = 0; k < 3; k++) {
+                unsigned int vertex = indices[triangle * 3 + k];
+                
+                result.push_back(vertex);
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+                liveCount[vertex]--;
+                simulateCache(vertex, cacheTime, time, cacheSize);
+            }
+            
+            emitted[triangle] = true;
+        }
+        
+        // prefer the oldest candidate that is still going to be in the cache after it has been fanned
+        int next = -1;
+        int bestPriority = -1;
+        
+        for (unsigned int vertex : candidates) {
+            if (liveCount[vertex] == 0) continue;
+            
+            int priority = 0;
+            
+            if (time - cacheTime[vertex] + 2 * liveCount[vertex] <= cacheSize) {
+                priority = time - cacheTime[vertex];
+            }
+            
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = vertex;
+            }
+        }
+        
+        if (next == -1) {
+            next = skipDeadEnd(liveCount, deadEnd, cursor);
+            
+            if (next >= 0 && result.size() / 3 > clusters.back()) {
+                clusters.push_back((unsigned int)result.size() / 3);
+            }
+        }
+        
+        fanning = next;
+    }
+    
+    return result;
+}
+
+std::vector<unsigned int> optimizeOverdraw(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& clusters, unsigned int cacheSize, float threshold) {
+    unsigned int triangleCount = (unsigned int)indices.size() / 3;
+    
+    if (triangleCount == 0 || clusters.empty()) return indices;
+    
+    std::vector<unsigned int> timestamps(positions.size(), 0);
+    unsigned int time = cacheSize + 1;
+    std::vector<unsigned int> softClusters;
+    
+    for (unsigned int c = 0; c < clusters.size(); c++) {
+        unsigned int start = clusters[c];
+        unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        
+        unsigned int clusterMisses = 0;
+        time += cacheSize + 1;
+        
+        for (unsigned int i = start * 3; i < end * 3; i++) {
+            clusterMisses += simulateCache(indices[i], timestamps, time, cacheSize);
+        }
+        
+        float clusterThreshold = threshold * (float)clusterMisses / (float)(end - start);
+        unsigned int runningMisses = 0;
+        unsigned int runningTriangles = 0;
+        
+        softClusters.push_back(start);
+        time += cacheSize + 1;
+        
+        for (unsigned int t = start; t < end; t++) {
+            for (unsigned int k = 0; k < 3; k++) {
+                runningMisses += simulateCache(indices[t * 3 + k], timestamps, time, cacheSize);
+            }
+            
+            runningTriangles++;
+            
+            if (t + 1 < end && (float)runningMisses / (float)runningTriangles <= clusterThreshold) {
+                softClusters.push_back(t + 1);
+                time += cacheSize + 1;
+                runningMisses = 0;
+                runningTriangles = 0;
+            }
+        }
+    }
+    
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    std::vector<float> sortKeys(softClusters.size());
+    
+    for (unsigned int t = 0; t < triangleCount; t++) {
+        const glm::vec3& a = positions[indices[t * 3]];
+        const glm::vec3& b = positions[indices[t * 3 + 1]];
+        const glm::vec3& c = positions[indices[t * 3 + 2]];
+        float area = glm::length(glm::cross(b - a, c - a));
+        
+        meshCentroid += area * (a + b + c) / 3.0f;
+        meshArea += area;
+    }
+    
+    if (meshArea > 0.0f) meshCentroid /= meshArea;
+    
+    for (unsigned int c = 0; c < softClusters.size(); c++) {
+        unsigned int start = softClusters[c];
+        unsigned int end = c + 1 < softClusters.size() ? softClusters[c + 1] : triangleCount;
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        
+        for (unsigned int t = start; t < end; t++) {
+            const glm::vec3& a = positions[indices[t * 3]];
+            const glm::vec3& b = positions[indices[t * 3 + 1]];
+            const glm::vec3& c = positions[indices[t * 3 + 2]];
+            glm::vec3 faceNormal = glm::cross(b - a, c - a);
+            float faceArea = glm::length(faceNormal);
+            
+            centroid += faceArea * (a + b + c) / 3.0f;
+            normal += faceNormal;
+            area += faceArea;
+        }
+        
+        if (area > 0.0f) centroid /= area;
+        if (glm::length(normal) > 0.0f) normal = glm::normalize(normal);
+        
+        sortKeys[c] = glm::dot(centroid - meshCentroid, normal);
+    }
+    
+    std::vector<unsigned int> order(softClusters.size());
+    for (unsigned int i = 0; i < order.size(); i++) order[i] = i;
+    
+    std::stable_sort(order.begin(), order.end(), [&sortKeys](unsigned int a, unsigned int b) {
+        return sortKeys[a] > sortKeys[b];
+    });
+    
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    
+    for (unsigned int c : order) {
+        unsigned int start = softClusters[c];
+        unsigned int end = c + 1 < softClusters.size() ? softClusters[c + 1] : triangleCount;
+        
+        result.insert(result.end(), indices.begin() + start * 3, indices.begin() + end * 3);
+    }
+    
+    return result;
+}
+
+std::vector<unsigned int> optimizeVertexFetch(std::vector<unsigned int>& indices, unsigned int vertexCount) {
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertexCount, unused);
+    std::vector<unsigned int> order;
+    order.reserve(vertexCount);
+    
+    for (unsigned int& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = (unsigned int)order.size();
+            order.push_back(index);
+        }
+        
+        index = remap[index];
+    }
+    
+    return order;
+}
+
+namespace {
+    // sum of squared distances to planes, weighted by triangle area
+    struct Quadric {
+        float a00, a11, a22, a01, a02, a12;
+        float b0, b1, b2;
+        float c;
+        float weight;
+        
+        void addPlane(const glm::vec3& normal, float distance, float w) {
+            a00 += w * normal.x * normal.x;
+            a11 += w * normal.y * normal.y;
+            a22 += w * normal.z * normal.z;
+            a01 += w * normal.x * normal.y;
+            a02 += w * normal.x * normal.z;
+            a12 += w * normal.y * normal.z;
+            b0 += w * normal.x * distance;
+            b1 += w * normal.y * distance;
+            b2 += w * normal.z * distance;
+            c += w * distance * distance;
+            weight += w;
+        }
+        
+        void add(const Quadric& other) {
+            a00 += other.a00; a11 += other.a11; a22 += other.a22;
+            a01 += other.a01; a02 += other.a02; a12 += other.a12;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+        }
+        
+        // mean squared distance of p to the planes
+        float evaluate(const glm::vec3& p) const {
+            float sum = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+                      + 2.0f * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                      + 2.0f * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            
+            return weight > 0.0f ? std::max(sum, 0.0f) / weight : 0.0f;
+        }
+    };
+    
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        float cost;
+    };
+}
+
+// moving from onto to must not turn any of the triangles that stay around from over
+static bool flips(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& offsets,
+                  const std::vector<unsigned int>& adjacency, unsigned int from, unsigned int to) {
+    for (unsigned int i = offsets[from]; i < offsets[from + 1]; i++) {
+        const unsigned int* triangle = &indices[adjacency[i] * 3];
+        
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+        
+        unsigned int k = triangle[0] == from ? 0 : triangle[1] == from ? 1 : 2;
+        const glm::vec3& b = positions[triangle[(k + 1) % 3]];
+        const glm::vec3& c = positions[triangle[(k + 2) % 3]];
+        
+        glm::vec3 before = glm::cross(b - positions[from], c - positions[from]);
+        glm::vec3 after = glm::cross(b - positions[to], c - positions[to]);
+        
+        if (glm::dot(before, after) <= 0.0f) return true;
+    }
+    
+    return false;
+}
+
+std::vector<unsigned int> simplifyMesh(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, unsigned int targetIndexCount, float& error) {
+    unsigned int vertexCount = (unsigned int)positions.size();
+    std::vector<unsigned int> result(indices);
+    std::vector<Quadric> quadrics(vertexCount, Quadric());
+    
+    for (unsigned int i = 0; i < indices.size(); i += 3) {
+        const glm::vec3& a = positions[indices[i]];
+        glm::vec3 normal = glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a);
+        float area = glm::length(normal);
+        
+        if (area == 0.0f) continue;
+        
+        normal /= area;
+        
+        for (unsigned int k = 0; k < 3; k++) quadrics[indices[i + k]].addPlane(normal, -glm::dot(normal, a), 0.5f * area);
+    }
+    
+    // an edge used by one triangle only is open, both its ends stay where they are
+    std::vector<unsigned char> locked(vertexCount, 0);
+    std::vector<std::pair<unsigned int, unsigned int>> edges;
+    edges.reserve(indices.size());
+    
+    for (unsigned int i = 0; i < indices.size(); i += 3) {
+        for (unsigned int k = 0; k < 3; k++) {
+            unsigned int a = indices[i + k];
+            unsigned int b = indices[i + (k + 1) % 3];
+            
+            edges.push_back({ std::min(a, b), std::max(a, b) });
+        }
+    }
+    
+    std::sort(edges.begin(), edges.end());
+    
+    for (unsigned int i = 0; i < edges.size(); ) {
+        unsigned int j = i + 1;
+        
+        while (j < edges.size() && edges[j] == edges[i]) j++;
+        
+        if (j - i == 1) locked[edges[i].first] = locked[edges[i].second] = 1;
+        
+        i = j;
+    }
+    
+    std::vector<unsigned int> offsets(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<unsigned char> touched(vertexCount);
+    std::vector<unsigned int> mark(vertexCount, ~0u);
+    std::vector<Collapse> collapses;
+    
+    error = 0.0f;
+    
+    // collapses of a pass touch disjoint neighbourhoods, so each one is checked against an up to date mesh
+    while (result.size() > targetIndexCount) {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (unsigned int index : result) offsets[index + 1]++;
+        for (unsigned int v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+        
+        adjacency.resize(result.size());
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (unsigned int i = 0; i < result.size(); i++) adjacency[fill[result[i]]++] = i / 3;
+        
+        collapses.clear();
+        
+        for (unsigned int i = 0; i < result.size(); i += 3) {
+            for (unsigned int k = 0; k < 3; k++) {
+                unsigned int a = result[i + k];
+                unsigned int b = result[i + (k + 1) % 3];
+                
+                if (!locked[a]) collapses.push_back({ a, b, quadrics[a].evaluate(positions[b]) });
+                if (!locked[b]) collapses.push_back({ b, a, quadrics[b].evaluate(positions[a]) });
+            }
+        }
+        
+        if (collapses.empty()) break;
+        
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost;
+        });
+        
+        for (unsigned int v = 0; v < vertexCount; v++) remap[v] = v;
+        std::fill(touched.begin(), touched.end(), 0);
+        
+        unsigned int removed = 0;
+        unsigned int needed = ((unsigned int)result.size() - targetIndexCount) / 3;
+        
+        for (const Collapse& collapse : collapses) {
+            if (removed >= needed) break;
+            
+            unsigned int from = collapse.from;
+            unsigned int to = collapse.to;
+            
+            if (touched[from] || touched[to]) continue;
+            
+            // the two ends may share only the two triangles on their edge, more would pinch the surface
+            unsigned int shared = 0;
+            unsigned int common = 0;
+            
+            for (unsigned int i = offsets[from]; i < offsets[from + 1]; i++) {
+                const unsigned int* triangle = &result[adjacency[i] * 3];
+                
+                for (unsigned int k = 0; k < 3; k++) mark[triangle[k]] = from;
+                
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to) shared++;
+            }
+            
+            for (unsigned int i = offsets[to]; i < offsets[to + 1]; i++) {
+                const unsigned int* triangle = &result[adjacency[i] * 3];
+                
+                for (unsigned int k = 0; k < 3; k++) {
+                    if (triangle[k] != from && triangle[k] != to && mark[triangle[k]] == from) {
+                        mark[triangle[k]] = ~0u;
+                        common++;
+                    }
+                }
+            }
+            
+            if (shared != 2 || common != 2) continue;
+            
+            if (flips(result, positions, offsets, adjacency, from, to)) continue;
+            
+            remap[from] = to;
+            quadrics[to].add(quadrics[from]);
+            error = std::max(error, std::sqrt(collapse.cost));
+            removed += 2;
+            
+            for (unsigned int i = offsets[from]; i < offsets[from + 1]; i++) {
+                const unsigned int* triangle = &result[adjacency[i] * 3];
+                
+                for (unsigned int k = 0; k < 3; k++) touched[triangle[k]] = 1;
+            }
+        }
+        
+        if (removed == 0) break;
+        
+        unsigned int write = 0;
+        
+        for (unsigned int i = 0; i < result.size(); i += 3) {
+            unsigned int a = remap[result[i]];
+            unsigned int b = remap[result[i + 1]];
+            unsigned int c = remap[result[i + 2]];
+            
+            if (a == b || b == c || c == a) continue;
+            
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        
+        result.resize(write);
+    }
+    
+    return result;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+float calculateACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize);
+
+// Tipsify (Sander et al. 2007). Fills clusters with the first triangle of every run that starts after a dead end.
+std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize, std::vector<unsigned int>& clusters);
+
+// Splits the Tipsify clusters while the cache stays within threshold of its cluster ACMR, then sorts clusters so outward facing ones are drawn first.
+std::vector<unsigned int> optimizeOverdraw(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& clusters, unsigned int cacheSize, float threshold);
+
+// Renumbers vertices in order of first use so vertex fetch walks the buffer linearly.
+std::vector<unsigned int> optimizeVertexFetch(std::vector<unsigned int>& indices, unsigned int vertexCount);
+
+// Quadric error edge collapse (Garland and Heckbert 1997) down to at most targetIndexCount indices where it can.
+// Vertices move onto a neighbour, so the result indexes the same vertex buffer. Vertices on an open edge, which
+// includes attribute seams split by deduplication, are kept in place. error receives the largest distance, in mesh
+// units, a collapsed vertex ended up from the planes of the triangles it merged.
+std::vector<unsigned int> simplifyMesh(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions, unsigned int targetIndexCount, float& error);
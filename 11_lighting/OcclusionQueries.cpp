@@ -0,0 +1,79 @@
+#include "OcclusionQueries.h"
+
+OcclusionQueries::OcclusionQueries(unsigned int count):
+    m_viewPosition(0.0f),
+    m_nearPlane(0.0f),
+    m_frame(0),
+    m_stats({ 0, 0, 0 })
+{
+    m_queries.resize(count);
+    m_visible.resize(count, 1);
+    m_pending.resize(count, 0);
+    
+    glGenQueries(count, m_queries.data());
+}
+
+void OcclusionQueries::beginFrame(const glm::vec3& viewPosition, float nearPlane) {
+    m_viewPosition = viewPosition;
+    m_nearPlane = nearPlane;
+    m_frame++;
+    m_stats = { 0, 0, 0 };
+    
+    for (unsigned int i = 0; i < m_queries.size(); i++) {
+        if (m_pending[i]) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(m_queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            
+            if (available) {
+                GLuint passed = 0;
+                glGetQueryObjectuiv(m_queries[i], GL_QUERY_RESULT, &passed);
+                
+                m_visible[i] = passed != 0;
+                m_pending[i] = 0;
+            }
+        }
+        
+        if (!m_visible[i]) m_stats.hidden++;
+    }
+}
+
+RenderQueue::Query OcclusionQueries::query(unsigned int object, const glm::vec4& bounds) {
+    RenderQueue::Query query = { m_queries[object], RenderQueue::occlusionNone, bounds };
+    
+    // with the camera in the box the near plane cuts away the faces in front, its query would say nothing
+    glm::vec3 offset = glm::abs(m_viewPosition - glm::vec3(bounds));
+    float reach = bounds.w + 2.0f * m_nearPlane;
+    
+    if (offset.x < reach && offset.y < reach && offset.z < reach) {
+        m_visible[object] = 1;
+        return query;
+    }
+    
+    // the query object is still in flight and can't be issued again, a hidden object is drawn conditioned on it as it
+    // is; waiting on an older frame's query costs the GPU nothing and the CPU never reads it
+    if (m_pending[object]) {
+        if (!m_visible[object]) {
+            query.occlusion = RenderQueue::occlusionReuse;
+            m_stats.reused++;
+        }
+        
+        return query;
+    }
+    
+    if (!m_visible[object]) {
+        query.occlusion = RenderQueue::occlusionTest;
+    } else if ((m_frame + object) % s_visibleInterval == 0) {
+        query.occlusion = RenderQueue::occlusionMeasure;
+    } else {
+        return query;
+    }
+    
+    m_pending[object] = 1;
+    m_stats.queries++;
+    
+    return query;
+}
+
+OcclusionQueries::Stats OcclusionQueries::stats() {
+    return m_stats;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "RenderQueue.h"
+
+// Hardware occlusion queries with temporal coherence, after CHC++. Every object keeps the visibility its last
+// query returned. Visible objects are drawn as usual, every few frames inside a query to notice when they vanish.
+// Hidden objects are tested each frame: the render queue draws them conditioned on a query of their bounding box,
+// so they come back the frame they are uncovered. Results are read a frame or more late and only once available; until
+// then a hidden object's draw stays conditioned on the query in flight rather than going out unconditionally.
+class OcclusionQueries {
+public:
+    struct Stats {
+        // objects whose last result said hidden
+        unsigned int hidden;
+        unsigned int queries;
+        // hidden objects drawn conditioned on a query still in flight
+        unsigned int reused;
+    };
+    
+    OcclusionQueries(unsigned int count);
+    // collects the results that arrived since the last frame
+    void beginFrame(const glm::vec3& viewPosition, float nearPlane);
+    // how object's draw is queried this frame, bounds is its world space bounding sphere
+    RenderQueue::Query query(unsigned int object, const glm::vec4& bounds);
+    Stats stats();
+    
+private:
+    std::vector<unsigned int> m_queries;
+    std::vector<unsigned char> m_visible;
+    // issued and not read back yet, the query object cannot be used again until it is
+    std::vector<unsigned char> m_pending;
+    glm::vec3 m_viewPosition;
+    float m_nearPlane;
+    unsigned int m_frame;
+    Stats m_stats;
+    
+    // visible objects are queried once in this many frames, staggered so each frame checks a share of them
+    static constexpr unsigned int s_visibleInterval = 8;
+};
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include "PostProcess.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+
+PostProcess::PostProcess(float bloomStrength):
+    m_downsampleProgram("./shaders/fullscreen-vs.glsl", "./shaders/bloom-downsample-fs.glsl"),
+    m_blurProgram("./shaders/fullscreen-vs.glsl", "./shaders/bloom-blur-fs.glsl"),
+    m_tonemapProgram("./shaders/fullscreen-vs.glsl", "./shaders/tonemap-fs.glsl"),
+    m_bloomStrength(bloomStrength),
+    m_scene(FrameGraph::none),
+    m_half(FrameGraph::none),
+    m_quarter(FrameGraph::none),
+    m_blurred(FrameGraph::none),
+    m_gpuTime(0.0f),
+    m_frame(0),
+    m_timing(false),
+    m_started(false)
+{
+    if (GLExtensions::gpuDriven) {
+        m_downsampleCompute.reset(new Shader("./shaders/bloom-downsample-cs.glsl"));
+        m_downsampleCompute->use();
+        m_downsampleCompute->setValue("source", 0);
+        m_downsampleCompute->setValue("threshold", s_threshold);
+        m_downsampleCompute->setValue("knee", s_knee * s_threshold);
+    }
+    
+    m_downsampleProgram.use();
+    m_downsampleProgram.setValue("source", 0);
+    m_downsampleProgram.setValue("threshold", s_threshold);
+    m_downsampleProgram.setValue("knee", s_knee * s_threshold);
+    
+    m_blurProgram.use();
+    m_blurProgram.setValue("source", 0);
+    
+    m_tonemapProgram.use();
+    m_tonemapProgram.setValue("scene", 0);
+    m_tonemapProgram.setValue("bloomHalf", 1);
+    m_tonemapProgram.setValue("bloomQuarter", 2);
+    m_tonemapProgram.setValue("bloomStrength", m_bloomStrength);
+    
+    for (unsigned int i = 0; i < s_queryFrames; i++) {
+        glGenQueries(2, m_queries[i]);
+        m_queryPending[i] = false;
+    }
+    
+    // the fullscreen triangle is generated from gl_VertexID, core profile still wants a VAO bound
+    glGenVertexArrays(1, &m_VAO);
+}
+
+FrameGraph::Resource PostProcess::addPasses(FrameGraph& graph, FrameGraph::Resource scene, FrameGraph::Resource output) {
+    readQueries();
+    
+    const FrameGraph::TextureDesc& desc = graph.desc(scene);
+    FrameGraph::TextureDesc half = { std::max(desc.width / 2, 1), std::max(desc.height / 2, 1), GL_R11F_G11F_B10F };
+    FrameGraph::TextureDesc quarter = { std::max(half.width / 2, 1), std::max(half.height / 2, 1), GL_R11F_G11F_B10F };
+    FrameGraph* frameGraph = &graph;
+    
+    m_scene = scene;
+    
+    if (m_downsampleCompute) {
+        graph.addPass("bloom downsample", [&](FrameGraph::Builder& builder) {
+            builder.read(scene);
+            m_half = builder.create("bloom half", half);
+            m_quarter = builder.create("bloom quarter", quarter);
+            builder.compute();
+        }, [this, frameGraph, half]() {
+            startTiming();
+            
+            GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, frameGraph->texture(m_scene));
+            glBindImageTexture(0, frameGraph->texture(m_half), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R11F_G11F_B10F);
+            glBindImageTexture(1, frameGraph->texture(m_quarter), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R11F_G11F_B10F);
+            
+            // each group writes an 8x8 block of the half level and the 4x4 block of the quarter level under it
+            m_downsampleCompute->use();
+            glDispatchCompute((half.width + s_groupSize - 1) / s_groupSize, (half.height + s_groupSize - 1) / s_groupSize, 1);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        });
+    } else {
+        graph.addPass("bloom half", [&](FrameGraph::Builder& builder) {
+            builder.read(scene);
+            m_half = builder.create("bloom half", half);
+        }, [this, frameGraph]() {
+            downsample(*frameGraph, m_scene, true);
+        });
+        
+        graph.addPass("bloom quarter", [&](FrameGraph::Builder& builder) {
+            builder.read(m_half);
+            m_quarter = builder.create("bloom quarter", quarter);
+        }, [this, frameGraph]() {
+            downsample(*frameGraph, m_half, false);
+        });
+    }
+    
+    FrameGraph::Resource horizontal = FrameGraph::none;
+    
+    graph.addPass("bloom blur horizontal", [&](FrameGraph::Builder& builder) {
+        builder.read(m_quarter);
+        horizontal = builder.create("bloom horizontal", quarter);
+    }, [this, frameGraph, quarter]() {
+        blur(*frameGraph, m_quarter, glm::vec2(1.0f / quarter.width, 0.0f));
+    });
+    
+    graph.addPass("bloom blur vertical", [&](FrameGraph::Builder& builder) {
+        builder.read(horizontal);
+        m_blurred = builder.create("bloom blurred", quarter);
+    }, [this, frameGraph, horizontal, quarter]() {
+        blur(*frameGraph, horizontal, glm::vec2(0.0f, 1.0f / quarter.height));
+    });
+    
+    graph.addPass("tone mapping", [&](FrameGraph::Builder& builder) {
+        builder.read(scene);
+        
+        if (m_bloomStrength > 0.0f) {
+            builder.read(m_half);
+            builder.read(m_blurred);
+        }
+        
+        if (output == FrameGraph::none) {
+            output = builder.create("tone mapped", { desc.width, desc.height, GL_RGBA8 });
+        } else {
+            builder.write(output);
+        }
+    }, [this, frameGraph]() {
+        startTiming();
+        
+        GLState::setDepthTest(false);
+        GLState::setDepthMask(false);
+        
+        GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, frameGraph->texture(m_scene));
+        
+        if (m_bloomStrength > 0.0f) {
+            GLState::bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, frameGraph->texture(m_half));
+            GLState::bindTexture(GL_TEXTURE2, GL_TEXTURE_2D, frameGraph->texture(m_blurred));
+        }
+        
+        m_tonemapProgram.use();
+        GLState::bindVertexArray(m_VAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        
+        GLState::setDepthMask(true);
+        GLState::setDepthTest(true);
+        
+        if (m_timing) {
+            glQueryCounter(m_queries[m_frame % s_queryFrames][1], GL_TIMESTAMP);
+            m_queryPending[m_frame % s_queryFrames] = true;
+        }
+        
+        m_frame++;
+    });
+    
+    return output;
+}
+
+float PostProcess::gpuTime() {
+    return m_gpuTime;
+}
+
+void PostProcess::readQueries() {
+    unsigned int slot = m_frame % s_queryFrames;
+    
+    m_timing = false;
+    m_started = false;
+    
+    if (!m_queryPending[slot]) return;
+    
+    GLuint available = 0;
+    glGetQueryObjectuiv(m_queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    
+    if (!available) return;
+    
+    GLuint64 start = 0;
+    GLuint64 end = 0;
+    
+    glGetQueryObjectui64v(m_queries[slot][0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(m_queries[slot][1], GL_QUERY_RESULT, &end);
+    
+    m_queryPending[slot] = false;
+    m_gpuTime = (end - start) / 1000000.0f;
+}
+
+void PostProcess::startTiming() {
+    if (m_started) return;
+    
+    unsigned int slot = m_frame % s_queryFrames;
+    
+    m_started = true;
+    // a frame whose query is still out goes untimed
+    m_timing = !m_queryPending[slot];
+    
+    if (m_timing) glQueryCounter(m_queries[slot][0], GL_TIMESTAMP);
+}
+
+void PostProcess::downsample(FrameGraph& graph, FrameGraph::Resource source, bool prefilter) {
+    startTiming();
+    
+    GLState::setDepthTest(false);
+    GLState::setDepthMask(false);
+    
+    GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, graph.texture(source));
+    
+    m_downsampleProgram.use();
+    m_downsampleProgram.setValue("prefilter", prefilter ? 1 : 0);
+    GLState::bindVertexArray(m_VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    
+    GLState::setDepthMask(true);
+    GLState::setDepthTest(true);
+}
+
+void PostProcess::blur(FrameGraph& graph, FrameGraph::Resource source, const glm::vec2& direction) {
+    startTiming();
+    
+    GLState::setDepthTest(false);
+    GLState::setDepthMask(false);
+    
+    GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, graph.texture(source));
+    
+    m_blurProgram.use();
+    m_blurProgram.setValue("direction", direction);
+    GLState::bindVertexArray(m_VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    
+    GLState::setDepthMask(true);
+    GLState::setDepthTest(true);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <memory>
+#include <glad/glad.h>
+#include "Shader.h"
+#include "FrameGraph.h"
+
+// HDR resolve at the end of the frame. Bloom takes what lies above a threshold down to half and quarter resolution,
+// in one compute dispatch where compute shaders are available and in two fragment passes otherwise, blurs the
+// quarter level and adds both back while tone mapping. Every intermediate is a frame graph transient; at these sizes
+// the chain stays a small share of the frame, which GL_TIMESTAMP queries around it keep track of.
+class PostProcess {
+public:
+    // the scene is lit into this instead of the 8 bit target
+    static constexpr GLenum hdrFormat = GL_RGBA16F;
+    
+    // 0 leaves bloom out, its passes are then culled
+    PostProcess(float bloomStrength);
+    // declares the passes resolving scene into output, which is created at the scene size when it is none
+    FrameGraph::Resource addPasses(FrameGraph& graph, FrameGraph::Resource scene, FrameGraph::Resource output);
+    // milliseconds, of the latest frame whose result arrived
+    float gpuTime();
+    
+private:
+    std::unique_ptr<Shader> m_downsampleCompute;
+    Shader m_downsampleProgram;
+    Shader m_blurProgram;
+    Shader m_tonemapProgram;
+    unsigned int m_VAO;
+    float m_bloomStrength;
+    FrameGraph::Resource m_scene;
+    FrameGraph::Resource m_half;
+    FrameGraph::Resource m_quarter;
+    FrameGraph::Resource m_blurred;
+    float m_gpuTime;
+    unsigned int m_frame;
+    // whether this frame's first pass got a query
+    bool m_timing;
+    bool m_started;
+    static constexpr unsigned int s_queryFrames = 3;
+    
+    unsigned int m_queries[s_queryFrames][2];
+    bool m_queryPending[s_queryFrames];
+    
+    static constexpr float s_threshold = 1.0f;
+    // share of the threshold below it that fades in
+    static constexpr float s_knee = 0.5f;
+    static constexpr unsigned int s_groupSize = 8;
+    
+    void readQueries();
+    // every pass starts timing, only the first that runs this frame does
+    void startTiming();
+    void downsample(FrameGraph& graph, FrameGraph::Resource source, bool prefilter);
+    void blur(FrameGraph& graph, FrameGraph::Resource source, const glm::vec2& direction);
+};
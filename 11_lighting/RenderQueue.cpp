@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include "RenderQueue.h"
+#include "GLState.h"
+#include "GLExtensions.h"
+#include "Uniforms.h"
+
+namespace {
+    // drawn under conditional rendering, after every box query
+    bool conditional(RenderQueue::Occlusion occlusion) {
+        return occlusion == RenderQueue::occlusionTest || occlusion == RenderQueue::occlusionReuse;
+    }
+}
+
+RenderQueue::RenderQueue(float farPlane, ThreadPool& threadPool):
+    m_farPlane(farPlane),
+    m_threadPool(threadPool),
+    m_depthProgram("./shaders/depth-vs.glsl", "./shaders/depth-fs.glsl"),
+    m_prepassMode(prepassOff),
+    m_prepass(false),
+    m_lastPrepass(false),
+    m_overdraw(0.0f),
+    m_visibleSamples(0),
+    m_sinceProbe(0),
+    m_frame(0),
+    m_objectStride(0),
+    m_stats({ 0, 0, 0, 0, 0, 0, 0, 0 })
+{
+    m_depthProgram.bindUniformBlock("Frame", FrameUniforms::binding);
+    m_depthProgram.bindUniformBlock("Object", ObjectUniforms::binding);
+    
+    glGenQueries(s_queryFrames, m_depthQueries);
+    glGenQueries(s_queryFrames, m_shadeQueries);
+    
+    for (unsigned int i = 0; i < s_queryFrames; i++) m_queryPending[i] = false;
+    
+    // unit cube for bounding box queries, drawn with the depth program
+    const float corners[] = {
+        -0.5f, -0.5f, -0.5f,   0.5f, -0.5f, -0.5f,  -0.5f,  0.5f, -0.5f,   0.5f,  0.5f, -0.5f,
+        -0.5f, -0.5f,  0.5f,   0.5f, -0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,   0.5f,  0.5f,  0.5f
+    };
+    
+    const unsigned char faces[] = {
+        0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5
+    };
+    
+    glGenVertexArrays(1, &m_boxVAO);
+    glGenBuffers(1, &m_boxVBO);
+    glGenBuffers(1, &m_boxEBO);
+    
+    GLState::bindVertexArray(m_boxVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, m_boxVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_boxEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+    
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    
+    GLState::bindVertexArray(0);
+    
+    // the conservative query may count samples a precise one would not, never the other way around
+    m_queryTarget = GLExtensions::conservativeQueries ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+}
+
+void RenderQueue::setDepthPrepass(Prepass mode) {
+    m_prepassMode = mode;
+    m_prepass = mode == prepassOn;
+}
+
+bool RenderQueue::depthPrepass() {
+    return m_lastPrepass;
+}
+
+float RenderQueue::overdraw() {
+    return m_overdraw;
+}
+
+void RenderQueue::push(Pass pass, Shader* program, Mesh* mesh, Texture* texture, const glm::mat4& model, const glm::vec3& color, float viewDepth,
+                       const Light* lights, unsigned int lightCount, const Query* query, unsigned int lod) {
+    uint64_t depth = (uint64_t)(glm::clamp(viewDepth / m_farPlane, 0.0f, 1.0f) * 0xffffff);
+    
+    // opaque front to back so early z rejects hidden fragments, blended back to front
+    if (pass == transparent) depth = 0xffffff - depth;
+    
+    uint64_t key = ((uint64_t)pass & 0xf) << 60;
+    key |= ((uint64_t)program->ID & 0xff) << 52;
+    key |= ((uint64_t)(texture ? texture->ID : 0) & 0xfff) << 40;
+    key |= ((uint64_t)mesh->VAO & 0xfff) << 28;
+    key |= depth << 4;
+    
+    lightCount = std::min(lightCount, (unsigned int)ObjectUniforms::maxLights);
+    
+    Query packetQuery = query ? *query : Query({ 0, occlusionNone, glm::vec4(0.0f) });
+    
+    // blended draws cannot wait for the opaque ones to fill the depth buffer, they only measure
+    if (pass != opaque && packetQuery.occlusion == occlusionTest) packetQuery.occlusion = occlusionMeasure;
+    if (pass != opaque && packetQuery.occlusion == occlusionReuse) packetQuery.occlusion = occlusionNone;
+    
+    m_packets.push_back({ key, program, mesh, lod, texture, model, color, (unsigned int)m_lights.size(), lightCount, packetQuery });
+    m_lights.insert(m_lights.end(), lights, lights + lightCount);
+}
+
+void RenderQueue::sort() {
+    unsigned int count = (unsigned int)m_packets.size();
+    
+    m_keys.resize(count);
+    m_keysTemp.resize(count);
+    m_order.resize(count);
+    m_orderTemp.resize(count);
+    
+    for (unsigned int i = 0; i < count; i++) {
+        m_keys[i] = m_packets[i].key;
+        m_order[i] = i;
+    }
+    
+    // LSD radix sort, one byte per pass, skipping bytes every key shares
+    for (unsigned int shift = 0; shift < 64; shift += 8) {
+        unsigned int histogram[256] = { 0 };
+        
+        for (uint64_t key : m_keys) histogram[(key >> shift) & 0xff]++;
+        
+        if (histogram[(m_keys[0] >> shift) & 0xff] == count) continue;
+        
+        unsigned int offset = 0;
+        
+        for (unsigned int& bucket : histogram) {
+            unsigned int size = bucket;
+            bucket = offset;
+            offset += size;
+        }
+        
+        for (unsigned int i = 0; i < count; i++) {
+            unsigned int slot = histogram[(m_keys[i] >> shift) & 0xff]++;
+            m_keysTemp[slot] = m_keys[i];
+            m_orderTemp[slot] = m_order[i];
+        }
+        
+        m_keys.swap(m_keysTemp);
+        m_order.swap(m_orderTemp);
+    }
+}
+
+void RenderQueue::submit(StreamBuffer& stream) {
+    if (m_packets.empty()) return;
+    
+    sort();
+    
+    unsigned int slot = m_frame++ % s_queryFrames;
+    
+    measure(slot);
+    
+    // auto mode still runs a pre-pass every so often, it is the only way to learn how many pixels are visible
+    bool prepass = m_prepass;
+    
+    if (m_prepassMode == prepassAuto && !prepass && (m_visibleSamples == 0 || ++m_sinceProbe >= s_probeInterval)) {
+        prepass = true;
+    }
+    
+    if (prepass) m_sinceProbe = 0;
+    
+    m_lastPrepass = prepass;
+    
+    // opaque draws sort first
+    unsigned int opaqueCount = 0;
+    
+    while (opaqueCount < m_order.size() && (m_packets[m_order[opaqueCount]].key >> 60) == opaque) opaqueCount++;
+    
+    // draws believed hidden go last, once everything that might hide them is in the depth buffer
+    auto tested = std::stable_partition(m_order.begin(), m_order.begin() + opaqueCount, [this](unsigned int index) {
+        return !conditional(m_packets[index].query.occlusion);
+    });
+    
+    unsigned int shadedCount = (unsigned int)(tested - m_order.begin());
+    
+    // box queries are few, they are set up here
+    m_boxAllocations.clear();
+    
+    for (unsigned int index : m_order) {
+        const Packet& packet = m_packets[index];
+        
+        if (packet.query.occlusion == occlusionNone || packet.query.occlusion == occlusionReuse) continue;
+        
+        StreamBuffer::Allocation allocation = stream.allocate(sizeof(ObjectUniforms));
+        ObjectUniforms* box = (ObjectUniforms*)allocation.data;
+        
+        box->model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(packet.query.bounds)), glm::vec3(2.0f * packet.query.bounds.w));
+        
+        stream.commit(allocation);
+        m_boxAllocations.push_back(allocation);
+    }
+    
+    // no job spans the first tested draw, the box queries go in between
+    m_jobs.clear();
+    addJobs(0, shadedCount);
+    
+    unsigned int testedJob = (unsigned int)m_jobs.size();
+    
+    addJobs(shadedCount, (unsigned int)m_order.size() - shadedCount);
+    
+    // both passes read the same per object uniforms, each job gets an allocation of its own to fill, small enough to
+    // always fit a region however many draws the frame has
+    m_objectStride = stream.alignedSize(sizeof(ObjectUniforms));
+    
+    for (Job& job : m_jobs) job.objects = stream.allocate(m_objectStride * job.count);
+    
+    if (m_depthCommands.size() < m_jobs.size()) {
+        m_depthCommands.resize(m_jobs.size());
+        m_shadeCommands.resize(m_jobs.size());
+    }
+    
+    m_jobStats.resize(m_jobs.size());
+    
+    m_threadPool.parallelFor((unsigned int)m_jobs.size(), [&](unsigned int job) {
+        record(job, stream, prepass, shadedCount);
+    });
+    
+    for (const Job& job : m_jobs) stream.commit(job.objects);
+    
+    for (const Stats& stats : m_jobStats) {
+        m_stats.draws += stats.draws;
+        m_stats.programChanges += stats.programChanges;
+        m_stats.vaoChanges += stats.vaoChanges;
+        m_stats.textureChanges += stats.textureChanges;
+        m_stats.lights += stats.lights;
+        m_stats.depthDraws += stats.depthDraws;
+    }
+    
+    m_stats.commandBuffers += (unsigned int)m_jobs.size();
+    
+    if (shadedCount > 0) {
+        if (prepass) {
+            glBeginQuery(GL_SAMPLES_PASSED, m_depthQueries[slot]);
+            GLState::setColorMask(false);
+            m_depthProgram.use();
+            
+            for (unsigned int job = 0; job < testedJob; job++) m_depthCommands[job].replay();
+            
+            GLState::setColorMask(true);
+            glEndQuery(GL_SAMPLES_PASSED);
+            
+            GLState::setDepthFunc(GL_EQUAL);
+            GLState::setDepthMask(false);
+        }
+        
+        glBeginQuery(GL_SAMPLES_PASSED, m_shadeQueries[slot]);
+        
+        m_queryPending[slot] = true;
+        m_queryPrepass[slot] = prepass;
+        
+        for (unsigned int job = 0; job < testedJob; job++) m_shadeCommands[job].replay();
+        
+        glEndQuery(GL_SAMPLES_PASSED);
+        
+        GLState::setDepthFunc(GL_LESS);
+        GLState::setDepthMask(true);
+    }
+    
+    if (!m_boxAllocations.empty()) drawBoxes(stream);
+    
+    for (unsigned int job = testedJob; job < m_jobs.size(); job++) m_shadeCommands[job].replay();
+    
+    m_packets.clear();
+    m_lights.clear();
+}
+
+void RenderQueue::addJobs(unsigned int first, unsigned int count) {
+    for (unsigned int offset = 0; offset < count; offset += s_jobSize) {
+        m_jobs.push_back({ first + offset, std::min(s_jobSize, count - offset), StreamBuffer::Allocation() });
+    }
+}
+
+void RenderQueue::record(unsigned int job, const StreamBuffer& stream, bool prepass, unsigned int shadedCount) {
+    const Job& range = m_jobs[job];
+    CommandBuffer& depthCommands = m_depthCommands[job];
+    CommandBuffer& shadeCommands = m_shadeCommands[job];
+    Stats& stats = m_jobStats[job];
+    
+    depthCommands.reset();
+    shadeCommands.reset();
+    stats = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    
+    // every job starts from unknown state, GLState drops what turns out not to change at the seams
+    Shader* program = NULL;
+    unsigned int vao = 0;
+    unsigned int depthVAO = 0;
+    Texture* texture = NULL;
+    
+    for (unsigned int i = range.first; i < range.first + range.count; i++) {
+        const Packet& packet = m_packets[m_order[i]];
+        GLintptr offset = m_objectStride * (i - range.first);
+        ObjectUniforms* object = (ObjectUniforms*)((unsigned char*)range.objects.data + offset);
+        
+        object->model = packet.model;
+        object->objectColor = glm::vec4(packet.color, 1.0f);
+        object->lightCount = glm::ivec4(packet.lightCount, 0, 0, 0);
+        
+        for (unsigned int l = 0; l < packet.lightCount; l++) {
+            const Light& light = m_lights[packet.lightOffset + l];
+            
+            object->lights[2 * l] = glm::vec4(light.position, light.radius);
+            object->lights[2 * l + 1] = glm::vec4(light.color * light.intensity, (float)light.shadowMap);
+        }
+        
+        const Mesh::Lod& lod = packet.mesh->lod(packet.lod);
+        CommandBuffer::BindBufferRange uniforms = { GL_UNIFORM_BUFFER, ObjectUniforms::binding, stream.ID, range.objects.offset + offset, sizeof(ObjectUniforms) };
+        CommandBuffer::DrawElements draw = { (GLsizei)lod.indexCount, packet.mesh->indexType(), packet.mesh->indexOffset(packet.lod) };
+        
+        if (prepass && i < shadedCount) {
+            if (packet.mesh->depthVAO != depthVAO) {
+                depthVAO = packet.mesh->depthVAO;
+                depthCommands.record(CommandBuffer::BindVertexArray({ depthVAO }));
+            }
+            
+            depthCommands.record(uniforms);
+            depthCommands.record(draw);
+            stats.depthDraws++;
+        }
+        
+        if (packet.program != program) {
+            program = packet.program;
+            shadeCommands.record(CommandBuffer::UseProgram({ program->ID }));
+            stats.programChanges++;
+        }
+        
+        if (packet.mesh->VAO != vao) {
+            vao = packet.mesh->VAO;
+            shadeCommands.record(CommandBuffer::BindVertexArray({ vao }));
+            stats.vaoChanges++;
+        }
+        
+        if (packet.texture && packet.texture != texture) {
+            texture = packet.texture;
+            shadeCommands.record(CommandBuffer::BindTexture({ GL_TEXTURE0, GL_TEXTURE_2D, texture->ID }));
+            stats.textureChanges++;
+        }
+        
+        shadeCommands.record(uniforms);
+        
+        // a tested draw waits on the GPU for its box query, the CPU never sees the result
+        if (conditional(packet.query.occlusion)) shadeCommands.record(CommandBuffer::BeginConditionalRender({ packet.query.id, GL_QUERY_WAIT }));
+        
+        shadeCommands.record(draw);
+        stats.draws++;
+        stats.lights += packet.lightCount;
+        
+        if (conditional(packet.query.occlusion)) shadeCommands.record(CommandBuffer::EndConditionalRender());
+    }
+}
+
+void RenderQueue::measure(unsigned int slot) {
+    if (!m_queryPending[slot]) return;
+    
+    GLuint available = 0;
+    glGetQueryObjectuiv(m_shadeQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    
+    // still in flight after a full round of frames, skip it rather than stall
+    m_queryPending[slot] = false;
+    
+    if (!available) return;
+    
+    GLuint shaded = 0;
+    glGetQueryObjectuiv(m_shadeQueries[slot], GL_QUERY_RESULT, &shaded);
+    
+    if (m_queryPrepass[slot]) {
+        // sorted the same way, the depth pass lets through what the shading pass would have shaded without it
+        GLuint tested = 0;
+        glGetQueryObjectuiv(m_depthQueries[slot], GL_QUERY_RESULT, &tested);
+        
+        m_visibleSamples = shaded;
+        m_overdraw = shaded > 0 ? (float)tested / shaded : 0.0f;
+    } else if (m_visibleSamples > 0) {
+        m_overdraw = (float)shaded / m_visibleSamples;
+    }
+    
+    if (m_prepassMode != prepassAuto) return;
+    
+    if (m_overdraw > s_enableOverdraw) {
+        m_prepass = true;
+    } else if (m_overdraw < s_disableOverdraw) {
+        m_prepass = false;
+    }
+}
+
+void RenderQueue::drawBoxes(StreamBuffer& stream) {
+    unsigned int box = 0;
+    
+    // every query is issued before the first draw waiting on one
+    GLState::setColorMask(false);
+    GLState::setDepthMask(false);
+    m_depthProgram.use();
+    GLState::bindVertexArray(m_boxVAO);
+    
+    for (unsigned int index : m_order) {
+        const Packet& packet = m_packets[index];
+        
+        if (packet.query.occlusion == occlusionNone || packet.query.occlusion == occlusionReuse) continue;
+        
+        stream.bindRange(ObjectUniforms::binding, m_boxAllocations[box++]);
+        
+        glBeginQuery(m_queryTarget, packet.query.id);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, (void*)0);
+        glEndQuery(m_queryTarget);
+        m_stats.boxDraws++;
+    }
+    
+    GLState::setDepthMask(true);
+    GLState::setColorMask(true);
+}
+
+RenderQueue::Stats RenderQueue::stats() {
+    return m_stats;
+}
+
+void RenderQueue::resetStats() {
+    m_stats = { 0, 0, 0, 0, 0, 0, 0, 0 };
+}
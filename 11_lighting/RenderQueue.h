@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Shader.h"
+#include "Mesh.h"
+#include "Texture.h"
+#include "StreamBuffer.h"
+#include "Light.h"
+#include "CommandBuffer.h"
+#include "ThreadPool.h"
+
+// Collects draws for a frame and submits them ordered by a 64 bit key:
+// pass (4) | program (8) | material (12) | VAO (12) | depth (24)
+// Opaque draws can be preceded by a depth only pass over the position stream, the shading pass then runs with
+// GL_EQUAL so each visible pixel is shaded once. In auto mode occlusion queries measure the overdraw and turn it on
+// only while the fragments it saves outweigh drawing everything twice.
+// Draws can carry an occlusion query on their bounding box, issued once the untested opaque draws are done. Tested
+// draws are believed hidden: they go last and are skipped on the GPU by conditional rendering unless their query passed,
+// or the one from an earlier frame when it is still in flight.
+// Once sorted, draws are prepared in jobs on the thread pool. Each job writes the object uniforms of a run of draws
+// and records its binds and draws into a command buffer, which the GL thread then replays in order.
+class RenderQueue {
+public:
+    enum Pass { opaque, transparent, overlay };
+    enum Prepass { prepassOff, prepassOn, prepassAuto };
+    // measure only queries the bounding box, test also draws conditioned on it, reuse draws conditioned on a query
+    // issued in an earlier frame and still in flight, without a box of its own
+    enum Occlusion { occlusionNone, occlusionMeasure, occlusionTest, occlusionReuse };
+    
+    struct Query {
+        unsigned int id;
+        Occlusion occlusion;
+        // world space bounding sphere, its cube is the box a test draws
+        glm::vec4 bounds;
+    };
+    
+    struct Packet {
+        uint64_t key;
+        Shader* program;
+        Mesh* mesh;
+        unsigned int lod;
+        Texture* texture;
+        glm::mat4 model;
+        glm::vec3 color;
+        // range of m_lights streamed with the draw
+        unsigned int lightOffset;
+        unsigned int lightCount;
+        Query query;
+    };
+    
+    struct Stats {
+        unsigned int draws;
+        unsigned int programChanges;
+        unsigned int vaoChanges;
+        unsigned int textureChanges;
+        unsigned int lights;
+        unsigned int depthDraws;
+        unsigned int boxDraws;
+        unsigned int commandBuffers;
+    };
+    
+    RenderQueue(float farPlane, ThreadPool& threadPool);
+    void setDepthPrepass(Prepass mode);
+    // whether the last submit drew a depth pre-pass
+    bool depthPrepass();
+    // fragments passing the depth test per visible pixel without a pre-pass, 0 until measured
+    float overdraw();
+    void push(Pass pass, Shader* program, Mesh* mesh, Texture* texture, const glm::mat4& model, const glm::vec3& color, float viewDepth,
+              const Light* lights = NULL, unsigned int lightCount = 0, const Query* query = NULL, unsigned int lod = 0);
+    void submit(StreamBuffer& stream);
+    // totals over every submit since the last reset
+    Stats stats();
+    void resetStats();
+    
+private:
+    struct Job {
+        unsigned int first;
+        unsigned int count;
+        // object uniforms of the job's draws in draw order, a stride apart
+        StreamBuffer::Allocation objects;
+    };
+    
+    float m_farPlane;
+    ThreadPool& m_threadPool;
+    Shader m_depthProgram;
+    unsigned int m_boxVAO;
+    unsigned int m_boxVBO;
+    unsigned int m_boxEBO;
+    GLenum m_queryTarget;
+    Prepass m_prepassMode;
+    bool m_prepass;
+    bool m_lastPrepass;
+    float m_overdraw;
+    GLuint m_visibleSamples;
+    unsigned int m_sinceProbe;
+    unsigned int m_frame;
+    // results are read a few frames late so the CPU never waits on them
+    static constexpr unsigned int s_queryFrames = 3;
+    
+    // fragments passing the depth test in the depth pass and in the opaque shading pass
+    unsigned int m_depthQueries[s_queryFrames];
+    unsigned int m_shadeQueries[s_queryFrames];
+    bool m_queryPending[s_queryFrames];
+    bool m_queryPrepass[s_queryFrames];
+    std::vector<Packet> m_packets;
+    std::vector<Light> m_lights;
+    std::vector<uint64_t> m_keys;
+    std::vector<uint64_t> m_keysTemp;
+    std::vector<unsigned int> m_order;
+    std::vector<unsigned int> m_orderTemp;
+    GLsizeiptr m_objectStride;
+    std::vector<Job> m_jobs;
+    std::vector<CommandBuffer> m_depthCommands;
+    std::vector<CommandBuffer> m_shadeCommands;
+    std::vector<Stats> m_jobStats;
+    // one per draw with a query, in draw order
+    std::vector<StreamBuffer::Allocation> m_boxAllocations;
+    Stats m_stats;
+    
+    // turn the pre-pass on above this overdraw, off below the second, and measure visible pixels again now and then
+    static constexpr float s_enableOverdraw = 1.5f;
+    static constexpr float s_disableOverdraw = 1.25f;
+    static constexpr unsigned int s_probeInterval = 120;
+    // draws per job, few enough that a small scene stays on one thread
+    static constexpr unsigned int s_jobSize = 256;
+    
+    void sort();
+    void measure(unsigned int slot);
+    // splits [first, first + count) into jobs
+    void addJobs(unsigned int first, unsigned int count);
+    // writes the object uniforms of a job and records its depth and shading commands, touches no GL
+    void record(unsigned int job, const StreamBuffer& stream, bool prepass, unsigned int shadedCount);
+    // bounding box queries of every draw carrying one, after the opaque draws that are not tested
+    void drawBoxes(StreamBuffer& stream);
+};
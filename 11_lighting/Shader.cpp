@@ -1,44 +1,59 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstring>
 #include <glm/gtc/type_ptr.hpp>
 #include "Shader.h"
+#include "GLState.h"
+#include "GLExtensions.h"
 
 Shader::Shader(const char* vPath, const char* fPath) {
-    std::ifstream vShaderFile, fShaderFile;
-    std::string vStrCode, fStrCode;
+    // keep the strings alive, c_str() of a temporary would dangle
+    std::string vStrCode = readFile(vPath);
+    std::string fStrCode = readFile(fPath);
     
-    vShaderFile.exceptions(std::ifstream::badbit | std::ifstream::failbit);
-    fShaderFile.exceptions(std::ifstream::badbit | std::ifstream::failbit);
+    unsigned int vShader = compileShader(vStrCode.c_str(), GL_VERTEX_SHADER);
+    unsigned int fShader = compileShader(fStrCode.c_str(), GL_FRAGMENT_SHADER);
+    ID = compileProgram(vShader, fShader);
     
-    try {
-        vShaderFile.open(vPath);
-        fShaderFile.open(fPath);
-        
-        std::stringstream vStream, fStream;
-        vStream << vShaderFile.rdbuf();
-        fStream << fShaderFile.rdbuf();
-        
-        vShaderFile.close();
-        fShaderFile.close();
-        
-        // for some reason vStream.str().c_str() DOESN'T WORK
-        vStrCode = vStream.str();
-        fStrCode = fStream.str();
-    } catch (std::ifstream::failure e) {
-        std::cout << "[ERROR] Failed to load shader " << strerror(errno) << std::endl;
-    }
+    glDeleteShader(vShader);
+    glDeleteShader(fShader);
+}
+
+Shader::Shader(const char* vPath, const char* gPath, const char* fPath) {
+    std::string vStrCode = readFile(vPath);
+    std::string gStrCode = readFile(gPath);
+    std::string fStrCode = readFile(fPath);
     
     unsigned int vShader = compileShader(vStrCode.c_str(), GL_VERTEX_SHADER);
+    unsigned int gShader = compileShader(gStrCode.c_str(), GL_GEOMETRY_SHADER);
     unsigned int fShader = compileShader(fStrCode.c_str(), GL_FRAGMENT_SHADER);
-    ID = compileProgram(vShader, fShader);
+    ID = compileProgram(vShader, gShader, fShader);
     
     glDeleteShader(vShader);
+    glDeleteShader(gShader);
     glDeleteShader(fShader);
 }
 
+Shader::Shader(const char* cPath) {
+    std::string cStrCode = readFile(cPath);
+    
+    unsigned int cShader = compileShader(cStrCode.c_str(), GL_COMPUTE_SHADER);
+    ID = compileProgram(cShader);
+    
+    glDeleteShader(cShader);
+}
+
 void Shader::use() {
-    glUseProgram(ID);
+    GLState::useProgram(ID);
+}
+
+void Shader::bindUniformBlock(const char* name, unsigned int binding) {
+    unsigned int index = glGetUniformBlockIndex(ID, name);
+    
+    if (index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(ID, index, binding);
+    }
 }
 
 void Shader::setValue(const char* name, float value) {
@@ -53,10 +68,61 @@ void Shader::setValue(const char* name, const glm::mat4& value) {
     glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, glm::value_ptr(value));
 }
 
+void Shader::setValue(const char* name, const glm::mat4* values, int count) {
+    glUniformMatrix4fv(glGetUniformLocation(ID, name), count, GL_FALSE, glm::value_ptr(values[0]));
+}
+
+void Shader::setValue(const char* name, const glm::vec2& value) {
+    glUniform2fv(glGetUniformLocation(ID, name), 1, glm::value_ptr(value));
+}
+
 void Shader::setValue(const char* name, const glm::vec3& value) {
     glUniform3fv(glGetUniformLocation(ID, name), 1, glm::value_ptr(value));
 }
 
+void Shader::setValue(const char* name, const glm::vec4& value) {
+    glUniform4fv(glGetUniformLocation(ID, name), 1, glm::value_ptr(value));
+}
+
+void Shader::setValue(const char* name, const glm::vec4* values, int count) {
+    glUniform4fv(glGetUniformLocation(ID, name), count, glm::value_ptr(values[0]));
+}
+
+std::string Shader::readFile(const char* path) {
+    std::ifstream file;
+    std::stringstream stream;
+    
+    file.exceptions(std::ifstream::badbit | std::ifstream::failbit);
+    
+    try {
+        file.open(path);
+        stream << file.rdbuf();
+        file.close();
+    } catch (std::ifstream::failure e) {
+        std::cout << "[ERROR] Failed to load shader " << path << " " << strerror(errno) << std::endl;
+    }
+    
+    // #include "file" lines are replaced by that file, looked up next to the one including it, so functions shared by
+    // several shaders live in one place
+    std::string source = stream.str();
+    std::string directory(path);
+    size_t slash = directory.find_last_of('/');
+    
+    directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+    
+    size_t include;
+    
+    while ((include = source.find("#include \"")) != std::string::npos) {
+        size_t nameStart = include + strlen("#include \"");
+        size_t nameEnd = source.find('"', nameStart);
+        std::string included = readFile((directory + source.substr(nameStart, nameEnd - nameStart)).c_str());
+        
+        source.replace(include, nameEnd + 1 - include, included);
+    }
+    
+    return source;
+}
+
 unsigned int Shader::compileShader(const char* src, const GLint type) {
     unsigned int id = glCreateShader(type);
     int success;
@@ -75,6 +141,25 @@ unsigned int Shader::compileShader(const char* src, const GLint type) {
     return id;
 }
 
+unsigned int Shader::compileProgram(unsigned int cShader) {
+    unsigned int id = glCreateProgram();
+    int success;
+    char log[512];
+    
+    glAttachShader(id, cShader);
+    
+    glLinkProgram(id);
+    
+    glGetProgramiv(id, GL_LINK_STATUS, &success);
+    
+    if (!success) {
+        glGetProgramInfoLog(id, 512, NULL, log);
+        std::cout << log << std::endl;
+    }
+    
+    return id;
+}
+
 unsigned int Shader::compileProgram(unsigned int vShader, unsigned int fShader) {
     unsigned int id = glCreateProgram();
     int success;
@@ -94,3 +179,24 @@ unsigned int Shader::compileProgram(unsigned int vShader, unsigned int fShader)
     
     return id;
 }
+
+unsigned int Shader::compileProgram(unsigned int vShader, unsigned int gShader, unsigned int fShader) {
+    unsigned int id = glCreateProgram();
+    int success;
+    char log[512];
+    
+    glAttachShader(id, vShader);
+    glAttachShader(id, gShader);
+    glAttachShader(id, fShader);
+    
+    glLinkProgram(id);
+    
+    glGetProgramiv(id, GL_LINK_STATUS, &success);
+    
+    if (!success) {
+        glGetProgramInfoLog(id, 512, NULL, log);
+        std::cout << log << std::endl;
+    }
+    
+    return id;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
@@ -8,13 +9,24 @@ public:
     unsigned int ID;
     
     Shader(const char* vPath, const char* fPath);
+    Shader(const char* vPath, const char* gPath, const char* fPath);
+    Shader(const char* cPath);
     void use();
+    void bindUniformBlock(const char* name, unsigned int binding);
     void setValue(const char* name, float value);
     void setValue(const char* name, int value);
     void setValue(const char* name, const glm::mat4& value);
+    void setValue(const char* name, const glm::mat4* values, int count);
+    void setValue(const char* name, const glm::vec2& value);
     void setValue(const char* name, const glm::vec3& value);
+    void setValue(const char* name, const glm::vec4& value);
+    void setValue(const char* name, const glm::vec4* values, int count);
     
 private:
+    // expands #include lines
+    std::string readFile(const char* path);
     unsigned int compileShader(const char* src, const GLint type);
     unsigned int compileProgram(unsigned int vShader, unsigned int fShader);
+    unsigned int compileProgram(unsigned int vShader, unsigned int gShader, unsigned int fShader);
+    unsigned int compileProgram(unsigned int cShader);
 };
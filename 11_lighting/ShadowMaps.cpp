@@ -0,0 +1,294 @@
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include "ShadowMaps.h"
+#include "GLState.h"
+#include "Frustum.h"
+
+constexpr int ShadowMaps::s_faceSizes[];
+
+ShadowMaps::ShadowMaps(Mesh& mesh, unsigned int count):
+    m_mesh(mesh),
+    m_program("./shaders/shadow-vs.glsl", "./shaders/shadow-gs.glsl", "./shaders/shadow-fs.glsl"),
+    m_batch(mesh),
+    m_count(count),
+    m_frame(0),
+    m_stats({ 0, 0, 0, 0 })
+{
+    m_slots.resize(m_count, { glm::vec3(0.0f), 0.0f, -1, false });
+    m_tileRects.resize(m_count, glm::vec4(0.0f));
+    
+    // one quadrant per face size, each packed with as many 3x2 face blocks as fit
+    const int quadrant = s_atlasSize / 2;
+    
+    for (int i = 0; i < 4; i++) {
+        int faceSize = s_faceSizes[i];
+        int originX = (i % 2) * quadrant;
+        int originY = (i / 2) * quadrant;
+        
+        for (int y = 0; y + 2 * faceSize <= quadrant; y += 2 * faceSize) {
+            for (int x = 0; x + 3 * faceSize <= quadrant; x += 3 * faceSize) {
+                m_tiles.push_back({ originX + x, originY + y, faceSize, -1, 0 });
+            }
+        }
+    }
+    
+    glGenTextures(1, &m_atlas);
+    GLState::bindTexture(GL_TEXTURE0 + unit, GL_TEXTURE_2D, m_atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, s_atlasSize, s_atlasSize, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    
+    // linear filtering on a comparison sampler blends four depth tests
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    
+    glGenFramebuffers(1, &m_framebuffer);
+    GLState::bindFramebuffer(m_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_atlas, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "[ERROR] Shadow atlas framebuffer is incomplete" << std::endl;
+    }
+    
+    GLState::bindFramebuffer(0);
+    
+    glGenBuffers(1, &m_tileBuffer);
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, m_tileBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, m_count * sizeof(glm::vec4), m_tileRects.data(), GL_DYNAMIC_DRAW);
+    
+    glGenTextures(1, &m_tileTexture);
+    GLState::bindTexture(GL_TEXTURE0 + tileUnit, GL_TEXTURE_BUFFER, m_tileTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_tileBuffer);
+}
+
+void ShadowMaps::setCasters(const std::vector<Instance>& casters) {
+    glm::vec4 bounds = m_mesh.boundingSphere();
+    
+    m_casters = casters;
+    m_casterBounds.clear();
+    
+    for (const Instance& caster : casters) {
+        glm::vec3 center(caster.model * glm::vec4(glm::vec3(bounds), 1.0f));
+        float scale = std::max(glm::length(caster.model[0]), std::max(glm::length(caster.model[1]), glm::length(caster.model[2])));
+        
+        m_casterBounds.push_back(glm::vec4(center, bounds.w * scale));
+    }
+    
+    for (Slot& slot : m_slots) slot.valid = false;
+}
+
+void ShadowMaps::update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, int height) {
+    Frustum frustum(projection * view);
+    
+    m_frame++;
+    m_requests.clear();
+    
+    // a light out of view can't reach a visible surface, it keeps its tile until someone needs the space
+    for (const Light& light : lights) {
+        if (light.shadowMap < 0 || light.shadowMap >= (int)m_count) continue;
+        if (!frustum.intersects(light.position, light.radius)) continue;
+        
+        // projected radius of the light's sphere in pixels, the camera inside it asks for the biggest tile
+        float distance = glm::length(glm::vec3(view * glm::vec4(light.position, 1.0f)));
+        float coverage = (float)s_faceSizes[0];
+        
+        if (distance > light.radius) {
+            coverage = light.radius / std::sqrt(distance * distance - light.radius * light.radius) * projection[1][1] * 0.5f * height;
+        }
+        
+        m_requests.push_back({ &light, coverage });
+    }
+    
+    // the biggest lights choose first, the rest fall back to smaller tiles when a quadrant runs out
+    std::sort(m_requests.begin(), m_requests.end(), [](const Request& a, const Request& b) {
+        return a.coverage > b.coverage;
+    });
+    
+    GLint viewport[4];
+    bool bound = false;
+    bool changed = false;
+    
+    for (const Request& request : m_requests) {
+        const Light& light = *request.light;
+        Slot& slot = m_slots[light.shadowMap];
+        int faceSize = s_faceSizes[0];
+        
+        for (int size : s_faceSizes) {
+            if (size >= request.coverage) faceSize = size;
+        }
+        
+        // grow right away, shrink only once the light fits faces a quarter of the current size, so a light near one
+        // size boundary doesn't flip between two tiles every frame
+        if (slot.tile >= 0) {
+            int current = m_tiles[slot.tile].faceSize;
+            
+            if (faceSize > current || 2 * faceSize < current) {
+                int tile = allocate(light.shadowMap, faceSize, false);
+                
+                if (tile >= 0) {
+                    m_tiles[slot.tile].owner = -1;
+                    slot.tile = tile;
+                    slot.valid = false;
+                    changed = true;
+                }
+            }
+        } else {
+            slot.tile = allocate(light.shadowMap, faceSize, true);
+            slot.valid = false;
+            changed = true;
+        }
+        
+        if (slot.tile < 0) {
+            m_stats.unshadowed++;
+            continue;
+        }
+        
+        Tile& tile = m_tiles[slot.tile];
+        tile.lastUsed = m_frame;
+        
+        if (slot.valid && slot.position == light.position && slot.radius == light.radius) {
+            m_stats.cached++;
+            continue;
+        }
+        
+        if (!bound) {
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            GLState::bindFramebuffer(m_framebuffer);
+            glViewport(0, 0, s_atlasSize, s_atlasSize);
+            bound = true;
+        }
+        
+        render(light, tile);
+        
+        slot.position = light.position;
+        slot.radius = light.radius;
+        slot.valid = true;
+        m_stats.rendered++;
+    }
+    
+    if (bound) {
+        GLState::bindFramebuffer(0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+    
+    if (!changed) return;
+    
+    for (unsigned int i = 0; i < m_count; i++) {
+        int tile = m_slots[i].tile;
+        
+        m_tileRects[i] = tile < 0 ? glm::vec4(0.0f) : glm::vec4(m_tiles[tile].x, m_tiles[tile].y, m_tiles[tile].faceSize, 0.0f) / (float)s_atlasSize;
+    }
+    
+    GLState::bindBuffer(GL_TEXTURE_BUFFER, m_tileBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, m_count * sizeof(glm::vec4), m_tileRects.data(), GL_DYNAMIC_DRAW);
+}
+
+void ShadowMaps::bindTextures() {
+    GLState::bindTexture(GL_TEXTURE0 + unit, GL_TEXTURE_2D, m_atlas);
+    GLState::bindTexture(GL_TEXTURE0 + tileUnit, GL_TEXTURE_BUFFER, m_tileTexture);
+}
+
+unsigned int ShadowMaps::count() {
+    return m_count;
+}
+
+ShadowMaps::Stats ShadowMaps::stats() {
+    return m_stats;
+}
+
+void ShadowMaps::resetStats() {
+    m_stats = { 0, 0, 0, 0 };
+}
+
+void ShadowMaps::setSamplers(Shader& program) {
+    program.use();
+    program.setValue("shadowAtlas", unit);
+    program.setValue("shadowTiles", tileUnit);
+}
+
+int ShadowMaps::allocate(unsigned int slot, int faceSize, bool smaller) {
+    int best = -1;
+    
+    // free tiles first, then the one unused for longest. Tiles used this frame are never taken
+    for (unsigned int i = 0; i < m_tiles.size(); i++) {
+        const Tile& tile = m_tiles[i];
+        
+        if (tile.faceSize != faceSize || (tile.owner >= 0 && tile.lastUsed == m_frame)) continue;
+        
+        if (best < 0 || (tile.owner < 0 && m_tiles[best].owner >= 0)
+            || ((tile.owner < 0) == (m_tiles[best].owner < 0) && tile.lastUsed < m_tiles[best].lastUsed)) {
+            best = i;
+        }
+    }
+    
+    if (best < 0) {
+        return smaller && faceSize > s_faceSizes[3] ? allocate(slot, faceSize / 2, true) : -1;
+    }
+    
+    Tile& tile = m_tiles[best];
+    
+    if (tile.owner >= 0) {
+        m_slots[tile.owner].tile = -1;
+        m_slots[tile.owner].valid = false;
+        m_stats.evicted++;
+    }
+    
+    tile.owner = slot;
+    
+    return best;
+}
+
+void ShadowMaps::render(const Light& light, const Tile& tile) {
+    // +x, -x, +y, -y, +z, -z with the up vectors of GL cube maps, the receiving shaders use the same bases
+    static const glm::vec3 forwards[] = {
+        glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+    };
+    static const glm::vec3 ups[] = {
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+        glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+    };
+    
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, s_nearPlane, light.radius);
+    glm::mat4 faces[6];
+    
+    for (int i = 0; i < 6; i++) {
+        faces[i] = projection * glm::lookAt(light.position, light.position + forwards[i], ups[i]);
+    }
+    
+    // casters out of range can't shadow anything the light reaches
+    m_visible.clear();
+    
+    for (unsigned int i = 0; i < m_casters.size(); i++) {
+        const glm::vec4& bounds = m_casterBounds[i];
+        
+        if (glm::length(glm::vec3(bounds) - light.position) < bounds.w + light.radius) m_visible.push_back(m_casters[i]);
+    }
+    
+    GLState::setScissorTest(true);
+    glScissor(tile.x, tile.y, 3 * tile.faceSize, 2 * tile.faceSize);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    GLState::setScissorTest(false);
+    
+    if (m_visible.empty()) return;
+    
+    m_batch.update(m_visible);
+    
+    m_program.use();
+    m_program.setValue("faces", faces, 6);
+    m_program.setValue("light", glm::vec4(light.position, light.radius));
+    m_program.setValue("tile", glm::vec4(tile.x, tile.y, tile.faceSize, 0.0f) / (float)s_atlasSize);
+    
+    // the faces share one viewport, clip planes keep every face inside its square
+    for (unsigned int i = 0; i < 4; i++) GLState::setClipDistance(i, true);
+    
+    m_batch.draw();
+    
+    for (unsigned int i = 0; i < 4; i++) GLState::setClipDistance(i, false);
+}
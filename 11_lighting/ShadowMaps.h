@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Shader.h"
+#include "Mesh.h"
+#include "InstanceBatch.h"
+#include "Light.h"
+
+// Omnidirectional shadows for point lights, kept in one fixed size depth atlas. A light's tile holds its six cube faces
+// in a 3x2 block and is filled in a single instanced draw where the geometry shader places each triangle on the faces
+// it covers. Faces store distance to the light over its radius; shaders find the tile of a slot in a texture buffer.
+// The atlas is split in quadrants of 512, 256, 128 and 64 texel faces. Lights in view get a tile in the quadrant
+// matching their screen size, taking the least recently used one when it is full, and keep it while out of view.
+// A tile is rendered again only after its light moved or got a new tile; casters never move once set.
+class ShadowMaps {
+public:
+    static constexpr int unit = 6;
+    static constexpr int tileUnit = 7;
+    
+    struct Stats {
+        unsigned int rendered;
+        unsigned int cached;
+        unsigned int evicted;
+        // lights in view left without a tile
+        unsigned int unshadowed;
+    };
+    
+    ShadowMaps(Mesh& mesh, unsigned int count);
+    // instances of mesh that cast shadows, replaces the previous casters and drops every map
+    void setCasters(const std::vector<Instance>& casters);
+    // assigns tiles to the shadowed lights in view and renders the stale ones, the framebuffer is 0 afterwards
+    void update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, int height);
+    void bindTextures();
+    unsigned int count();
+    Stats stats();
+    void resetStats();
+    
+    static void setSamplers(Shader& program);
+    
+private:
+    struct Slot {
+        glm::vec3 position;
+        float radius;
+        int tile;
+        bool valid;
+    };
+    
+    struct Tile {
+        int x;
+        int y;
+        int faceSize;
+        int owner;
+        unsigned int lastUsed;
+    };
+    
+    struct Request {
+        const Light* light;
+        float coverage;
+    };
+    
+    Mesh& m_mesh;
+    Shader m_program;
+    InstanceBatch m_batch;
+    unsigned int m_framebuffer;
+    unsigned int m_atlas;
+    unsigned int m_tileBuffer;
+    unsigned int m_tileTexture;
+    unsigned int m_count;
+    unsigned int m_frame;
+    std::vector<Slot> m_slots;
+    // tiles of the biggest faces first
+    std::vector<Tile> m_tiles;
+    // per slot: atlas position and face size in texture coordinates, zero size without a tile
+    std::vector<glm::vec4> m_tileRects;
+    std::vector<Request> m_requests;
+    std::vector<Instance> m_casters;
+    // world space bounding sphere of every caster
+    std::vector<glm::vec4> m_casterBounds;
+    std::vector<Instance> m_visible;
+    Stats m_stats;
+    
+    static constexpr int s_atlasSize = 4096;
+    static constexpr int s_faceSizes[] = { 512, 256, 128, 64 };
+    static constexpr float s_nearPlane = 0.05f;
+    
+    // a tile of faceSize or, when smaller is set and none can be taken, of the next sizes down. -1 when nothing is left
+    int allocate(unsigned int slot, int faceSize, bool smaller);
+    void render(const Light& light, const Tile& tile);
+};
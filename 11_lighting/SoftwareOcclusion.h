@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <glm/glm.hpp>
+#include "ThreadPool.h"
+
+// CPU occlusion culling for when reading back GPU depth or running compute is not an option. A few simple occluder
+// meshes are rasterized into a small depth buffer, one screen tile per job, and bounding spheres are tested against it
+// before anything is submitted. Rasterization is conservative: a pixel is written only when the triangle covers all
+// of it, with the farthest depth the triangle has inside it, so occluders can only ever hide too little.
+// Each 8x8 block keeps its farthest depth, most tests are decided by those without visiting single pixels.
+class SoftwareOcclusion {
+public:
+    struct Occluder {
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> indices;
+    };
+    
+    struct Stats {
+        unsigned int triangles;
+        unsigned int tested;
+        unsigned int culled;
+        // milliseconds
+        float rasterTime;
+        float testTime;
+    };
+    
+    // the simplest occluder there is, fine for anything box shaped
+    static Occluder box(const glm::vec3& min, const glm::vec3& max);
+    
+    SoftwareOcclusion(ThreadPool& threadPool, int width = 320, int height = 192);
+    // starts a frame, drops the occluders of the previous one
+    void begin(const glm::mat4& view, const glm::mat4& projection);
+    void addOccluder(const Occluder& occluder, const glm::mat4& model);
+    void rasterize();
+    // world space bounding spheres, visible[i] is 0 for the hidden ones
+    void test(const std::vector<glm::vec4>& spheres, std::vector<unsigned char>& visible);
+    Stats stats();
+    
+private:
+    struct Triangle {
+        // x, y in buffer pixels and depth in [0, 1]
+        glm::vec3 v[3];
+        glm::ivec4 bounds;
+    };
+    
+    ThreadPool& m_threadPool;
+    int m_width;
+    int m_height;
+    int m_tilesX;
+    int m_tilesY;
+    glm::mat4 m_viewProjection;
+    std::vector<float> m_depth;
+    // farthest depth of every block
+    std::vector<float> m_blockDepth;
+    std::vector<Triangle> m_triangles;
+    std::vector<std::vector<unsigned int>> m_bins;
+    std::vector<glm::vec4> m_clip;
+    Stats m_stats;
+    std::chrono::steady_clock::time_point m_start;
+    
+    static constexpr int s_tileSize = 32;
+    static constexpr int s_blockSize = 8;
+    static constexpr unsigned int s_testBatch = 256;
+    
+    void rasterizeTile(unsigned int tile);
+    bool occluded(const glm::vec4& sphere);
+};
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include "StreamBuffer.h"
+#include "GLState.h"
+#include "GLExtensions.h"
+
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr frameSize, unsigned int frameCount):
+    m_target(target),
+    m_frameCount(frameCount),
+    m_frame(0),
+    m_offset(0),
+    m_persistent(GLExtensions::bufferStorage),
+    m_mapped(NULL),
+    m_fences(frameCount, (GLsync)0)
+{
+    GLint alignment = 16;
+    
+    if (target == GL_UNIFORM_BUFFER) {
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    }
+    
+    m_alignment = alignment;
+    m_frameSize = (frameSize + m_alignment - 1) / m_alignment * m_alignment;
+    
+    glGenBuffers(1, &ID);
+    GLState::bindBuffer(m_target, ID);
+    
+    if (m_persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        
+        glBufferStorage(m_target, m_frameSize * m_frameCount, NULL, flags);
+        m_mapped = (unsigned char*)glMapBufferRange(m_target, 0, m_frameSize * m_frameCount, flags);
+    } else {
+        glBufferData(m_target, m_frameSize * m_frameCount, NULL, GL_STREAM_DRAW);
+        m_staging.resize(m_frameSize * m_frameCount);
+        m_mapped = m_staging.data();
+    }
+}
+
+void StreamBuffer::beginFrame() {
+    GLsync fence = m_fences[m_frame];
+    
+    if (fence) {
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        
+        while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED) {
+            flags = 0;
+        }
+        
+        glDeleteSync(fence);
+        m_fences[m_frame] = 0;
+    }
+    
+    m_offset = 0;
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(GLsizeiptr size) {
+    GLsizeiptr aligned = alignedSize(size);
+    
+    if (aligned > m_frameSize) {
+        std::cout << "[ERROR] StreamBuffer: " << aligned << " bytes requested at once, more than the frame region of " << m_frameSize << std::endl;
+        std::abort();
+    }
+    
+    // draws earlier in the frame still read the rest of the region and the regions around it belong to frames in
+    // flight, there is nowhere to put this without corrupting one of them
+    if (m_offset + aligned > m_frameSize) {
+        std::cout << "[ERROR] StreamBuffer frame region of " << m_frameSize << " bytes exhausted" << std::endl;
+        std::abort();
+    }
+    
+    GLintptr offset = m_frame * m_frameSize + m_offset;
+    m_offset += aligned;
+    
+    return { m_mapped + offset, offset, size };
+}
+
+GLsizeiptr StreamBuffer::alignedSize(GLsizeiptr size) {
+    return (size + m_alignment - 1) / m_alignment * m_alignment;
+}
+
+void StreamBuffer::commit(const Allocation& allocation) {
+    if (m_persistent) return;
+    
+    // the fence guarantees the GPU is done with this range, so the driver must not synchronize
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    
+    GLState::bindBuffer(m_target, ID);
+    void* dst = glMapBufferRange(m_target, allocation.offset, allocation.size, flags);
+    memcpy(dst, allocation.data, allocation.size);
+    glUnmapBuffer(m_target);
+}
+
+void StreamBuffer::bindRange(GLuint index, const Allocation& allocation) {
+    GLState::bindBufferRange(m_target, index, ID, allocation.offset, allocation.size);
+}
+
+void StreamBuffer::endFrame() {
+    m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_frame = (m_frame + 1) % m_frameCount;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+
+// Ring buffer split into one region per frame in flight. A region is only written again after the fence
+// placed at the end of the frame that last used it has signaled, so writes never wait on the driver.
+class StreamBuffer {
+public:
+    struct Allocation {
+        void* data;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+    
+    unsigned int ID;
+    
+    StreamBuffer(GLenum target, GLsizeiptr frameSize, unsigned int frameCount);
+    void beginFrame();
+    // a frame's allocations must fit its region, running out is fatal rather than overwriting live uniforms
+    Allocation allocate(GLsizeiptr size);
+    // size rounded up to the offset alignment of bound ranges, for one allocation split into many of them
+    GLsizeiptr alignedSize(GLsizeiptr size);
+    void commit(const Allocation& allocation);
+    void bindRange(GLuint index, const Allocation& allocation);
+    void endFrame();
+    
+private:
+    GLenum m_target;
+    GLsizeiptr m_frameSize;
+    GLsizeiptr m_alignment;
+    unsigned int m_frameCount;
+    unsigned int m_frame;
+    GLsizeiptr m_offset;
+    bool m_persistent;
+    unsigned char* m_mapped;
+    // without glBufferStorage allocations are written here and copied with an unsynchronized map on commit
+    std::vector<unsigned char> m_staging;
+    std::vector<GLsync> m_fences;
+};
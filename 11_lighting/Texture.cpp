@@ -2,6 +2,7 @@
 #include <glad/glad.h>
 #include <stb/stb_image.h>
 #include "Texture.h"
+#include "GLState.h"
 
 Texture::Texture() {}
 
@@ -9,7 +10,7 @@ Texture::Texture(const char* path, FileType type) {
     GLenum format = type == FileType::png ? GL_RGBA : GL_RGB;
     
     glGenTextures(1, &ID);
-    glBindTexture(GL_TEXTURE_2D, ID);
+    GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, ID);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -30,6 +31,5 @@ Texture::Texture(const char* path, FileType type) {
 }
 
 void Texture::bind(GLenum unit) {
-    glActiveTexture(unit);
-    glBindTexture(GL_TEXTURE_2D, ID);
+    GLState::bindTexture(unit, GL_TEXTURE_2D, ID);
 }
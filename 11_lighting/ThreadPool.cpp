@@ -0,0 +1,83 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int workerCount):
+    m_job(NULL),
+    m_count(0),
+    m_next(0),
+    m_busy(0),
+    m_generation(0),
+    m_stop(false)
+{
+    if (workerCount == 0) {
+        unsigned int hardware = std::thread::hardware_concurrency();
+        workerCount = hardware > 1 ? hardware - 1 : 0;
+    }
+    
+    for (unsigned int i = 0; i < workerCount; i++) {
+        m_workers.push_back(std::thread(&ThreadPool::work, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    
+    m_wake.notify_all();
+    
+    for (std::thread& worker : m_workers) worker.join();
+}
+
+void ThreadPool::parallelFor(unsigned int count, const std::function<void(unsigned int)>& job) {
+    if (count == 0) return;
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &job;
+        m_count = count;
+        m_next = 0;
+        m_busy = (unsigned int)m_workers.size();
+        m_generation++;
+    }
+    
+    m_wake.notify_all();
+    runJobs();
+    
+    // every worker has to check in, even one that woke up after the items ran out, before job goes out of scope
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_busy == 0; });
+}
+
+unsigned int ThreadPool::threadCount() {
+    return (unsigned int)m_workers.size() + 1;
+}
+
+void ThreadPool::work() {
+    unsigned int generation = 0;
+    
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop || m_generation != generation; });
+            
+            if (m_stop) return;
+            
+            generation = m_generation;
+        }
+        
+        runJobs();
+        
+        std::lock_guard<std::mutex> lock(m_mutex);
+        
+        if (--m_busy == 0) m_done.notify_one();
+    }
+}
+
+void ThreadPool::runJobs() {
+    unsigned int index;
+    
+    while ((index = m_next++) < m_count) {
+        (*m_job)(index);
+    }
+}
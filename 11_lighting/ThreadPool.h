@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data parallel loops. The calling thread takes part in every loop,
+// so a pool without workers simply runs the loop inline.
+class ThreadPool {
+public:
+    // 0 picks one worker per hardware thread besides the caller
+    ThreadPool(unsigned int workerCount = 0);
+    ~ThreadPool();
+    // runs job(i) for every i below count and returns when all of them are done; items are handed out one at a time
+    void parallelFor(unsigned int count, const std::function<void(unsigned int)>& job);
+    // workers plus the calling thread
+    unsigned int threadCount();
+    
+private:
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const std::function<void(unsigned int)>* m_job;
+    unsigned int m_count;
+    std::atomic<unsigned int> m_next;
+    unsigned int m_busy;
+    unsigned int m_generation;
+    bool m_stop;
+    
+    void work();
+    void runJobs();
+};
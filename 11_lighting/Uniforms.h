@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// std140 layouts of the uniform blocks shared by the shaders, vec3 values are padded to vec4
+
+struct FrameUniforms {
+    static constexpr unsigned int binding = 0;
+    
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 lightPos;
+    glm::vec4 lightColor;
+    glm::vec4 viewPos;
+};
+
+struct ObjectUniforms {
+    static constexpr unsigned int binding = 1;
+    static constexpr unsigned int maxLights = 8;
+    
+    glm::mat4 model;
+    glm::vec4 objectColor;
+    // x is the number of lights reaching the object, strongest first
+    glm::ivec4 lightCount;
+    // two per light: world position and radius, color times intensity and shadow map
+    glm::vec4 lights[2 * maxLights];
+};
+
+struct ClusterUniforms {
+    static constexpr unsigned int binding = 2;
+    
+    // clusters along x, y and z, w is the number of lights
+    glm::uvec4 gridSize;
+    glm::vec4 screenSize;
+    // slice = log(viewDepth) * x + y, z and w are the near and far planes
+    glm::vec4 depthSlicing;
+    glm::mat4 inverseProjection;
+};
@@ -0,0 +1,115 @@
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+#include "VertexFormat.h"
+
+VertexFormat VertexFormat::standard() {
+    return { floatPosition, floatNormal, floatTexCoords };
+}
+
+VertexFormat VertexFormat::compact() {
+    return { halfPosition, packedNormal, noTexCoords };
+}
+
+VertexFormat VertexFormat::compactTextured() {
+    return { halfPosition, packedNormal, halfTexCoords };
+}
+
+unsigned int VertexFormat::positionSize() const {
+    // four halves keep the attribute 4 byte aligned, w is written as 1.0
+    return position == floatPosition ? 3 * sizeof(float) : 4 * sizeof(unsigned short);
+}
+
+unsigned int VertexFormat::normalSize() const {
+    return normal == floatNormal ? 3 * sizeof(float) : sizeof(unsigned int);
+}
+
+unsigned int VertexFormat::texCoordsSize() const {
+    switch (texCoords) {
+        case floatTexCoords: return 2 * sizeof(float);
+        case halfTexCoords: return 2 * sizeof(unsigned short);
+        default: return 0;
+    }
+}
+
+unsigned int VertexFormat::stride() const {
+    return positionSize() + normalSize() + texCoordsSize();
+}
+
+void VertexFormat::writePosition(unsigned char* dst, const glm::vec3& pos) const {
+    if (position == floatPosition) {
+        memcpy(dst, &pos, 3 * sizeof(float));
+    } else {
+        unsigned short halves[4] = {
+            glm::packHalf1x16(pos.x), glm::packHalf1x16(pos.y), glm::packHalf1x16(pos.z), glm::packHalf1x16(1.0f)
+        };
+        memcpy(dst, halves, sizeof(halves));
+    }
+}
+
+void VertexFormat::write(unsigned char* dst, const glm::vec3& pos, const glm::vec3& norm, const glm::vec2& uv) const {
+    writePosition(dst, pos);
+    dst += positionSize();
+    
+    if (normal == floatNormal) {
+        memcpy(dst, &norm, 3 * sizeof(float));
+    } else {
+        unsigned int packed = packNormal(norm);
+        memcpy(dst, &packed, sizeof(packed));
+    }
+    
+    dst += normalSize();
+    
+    if (texCoords == floatTexCoords) {
+        memcpy(dst, &uv, 2 * sizeof(float));
+    } else if (texCoords == halfTexCoords) {
+        unsigned short halves[2] = { glm::packHalf1x16(uv.x), glm::packHalf1x16(uv.y) };
+        memcpy(dst, halves, sizeof(halves));
+    }
+}
+
+void VertexFormat::setAttributes() const {
+    GLsizei size = stride();
+    unsigned int offset = 0;
+    
+    if (position == floatPosition) {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, size, (void*)(size_t)offset);
+    } else {
+        glVertexAttribPointer(0, 4, GL_HALF_FLOAT, GL_FALSE, size, (void*)(size_t)offset);
+    }
+    
+    glEnableVertexAttribArray(0);
+    offset += positionSize();
+    
+    if (normal == floatNormal) {
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, size, (void*)(size_t)offset);
+    } else {
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, size, (void*)(size_t)offset);
+    }
+    
+    glEnableVertexAttribArray(1);
+    offset += normalSize();
+    
+    if (texCoords == noTexCoords) return;
+    
+    glVertexAttribPointer(2, 2, texCoords == floatTexCoords ? GL_FLOAT : GL_HALF_FLOAT, GL_FALSE, size, (void*)(size_t)offset);
+    glEnableVertexAttribArray(2);
+}
+
+void VertexFormat::setPositionAttributes() const {
+    if (position == floatPosition) {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, positionSize(), (void*)0);
+    } else {
+        glVertexAttribPointer(0, 4, GL_HALF_FLOAT, GL_FALSE, positionSize(), (void*)0);
+    }
+    
+    glEnableVertexAttribArray(0);
+}
+
+unsigned int packNormal(const glm::vec3& normal) {
+    glm::vec3 n = glm::clamp(normal, -1.0f, 1.0f) * 511.0f;
+    unsigned int x = (unsigned int)(int)glm::round(n.x) & 0x3ff;
+    unsigned int y = (unsigned int)(int)glm::round(n.y) & 0x3ff;
+    unsigned int z = (unsigned int)(int)glm::round(n.z) & 0x3ff;
+    
+    return x | (y << 10) | (z << 20);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+struct VertexFormat {
+    enum Position { floatPosition, halfPosition };
+    enum Normal { floatNormal, packedNormal };
+    enum TexCoords { noTexCoords, floatTexCoords, halfTexCoords };
+    
+    Position position;
+    Normal normal;
+    TexCoords texCoords;
+    
+    // 32 bytes, the layout the cube vertices are authored in
+    static VertexFormat standard();
+    // 12 bytes: half positions and GL_INT_2_10_10_10_REV normals, texture coordinates dropped
+    static VertexFormat compact();
+    // 16 bytes: compact plus half texture coordinates
+    static VertexFormat compactTextured();
+    
+    unsigned int stride() const;
+    void write(unsigned char* dst, const glm::vec3& pos, const glm::vec3& norm, const glm::vec2& uv) const;
+    void setAttributes() const;
+    // position only stream for depth passes, encoded exactly like the position of the full vertex
+    unsigned int positionSize() const;
+    void writePosition(unsigned char* dst, const glm::vec3& pos) const;
+    void setPositionAttributes() const;
+    
+private:
+    unsigned int normalSize() const;
+    unsigned int texCoordsSize() const;
+};
+
+unsigned int packNormal(const glm::vec3& normal);
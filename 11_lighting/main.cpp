@@ -1,5 +1,11 @@
 #include <iostream>
 #include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <thread>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -8,6 +14,32 @@
 #include "Shader.h"
 #include "Texture.h"
 #include "Camera.h"
+#include "Mesh.h"
+#include "InstanceBatch.h"
+#include "GLExtensions.h"
+#include "GpuCuller.h"
+#include "HiZBuffer.h"
+#include "Frustum.h"
+#include "StreamBuffer.h"
+#include "Uniforms.h"
+#include "RenderQueue.h"
+#include "GLState.h"
+#include "Light.h"
+#include "GBuffer.h"
+#include "DeferredLighting.h"
+#include "ClusteredLighting.h"
+#include "ThreadPool.h"
+#include "LightGrid.h"
+#include "ShadowMaps.h"
+#include "SoftwareOcclusion.h"
+#include "OcclusionQueries.h"
+#include "LodSelector.h"
+#include "DynamicResolution.h"
+#include "FramePacer.h"
+#include "FrameScheduler.h"
+#include "FrameGraph.h"
+#include "PostProcess.h"
+#include "FrameQueue.h"
 
 int width = 800;
 int height = 600;
@@ -16,6 +48,8 @@ float last_xpos = (float)width / 2.0f;
 float last_ypos = (float)height / 2.0f;
 
 float fov = 45.0f;
+float near_plane = 0.1f;
+float far_plane = 100.0f;
 
 float last_frame = 0.0f;
 float delta_time = 0.0f;
@@ -33,10 +67,35 @@ Camera camera({
 
 bool right_mouse_btn_pressed = false;
 
+unsigned int stress_instances = 0;
+unsigned int scene_objects = 0;
+bool gpu_culling = false;
+bool hiz_culling = false;
+bool cpu_occlusion = false;
+bool occlusion_queries = false;
+unsigned int occlusion_benchmark = 0;
+bool deferred_shading = false;
+bool clustered_shading = false;
+bool cpu_binning = false;
+unsigned int light_count = 1;
+unsigned int shadow_lights = 1;
+RenderQueue::Prepass depth_prepass = RenderQueue::prepassAuto;
+bool sphere_mesh = false;
+float lod_threshold = 1.0f;
+float resolution_budget = 0.0f;
+DynamicResolution::Upscale upscale = DynamicResolution::sharpen;
+int swap_interval = 1;
+float frame_limit = 0.0f;
+unsigned int frames_in_flight = 2;
+bool hdr = false;
+float bloom_strength = 0.3f;
+bool single_thread = false;
+
 void framebuffer_size_callback(GLFWwindow* window, int new_width, int new_height) {
     width = new_width;
     height = new_height;
-    glViewport(0, 0, width, height);
+    // no GL here, this runs on the main thread while the render thread owns the context; every frame graph pass sets
+    // its own viewport from the packet's size
 }
 
 void mouse_pos_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -121,14 +180,278 @@ void process_input(GLFWwindow* window) {
     process_camera_move(window);
 }
 
+void parse_args(int argc, const char * argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            stress_instances = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+            scene_objects = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--gpu-culling") == 0) {
+            gpu_culling = true;
+        } else if (strcmp(argv[i], "--hiz-culling") == 0) {
+            hiz_culling = true;
+        } else if (strcmp(argv[i], "--cpu-occlusion") == 0) {
+            cpu_occlusion = true;
+        } else if (strcmp(argv[i], "--occlusion-queries") == 0) {
+            occlusion_queries = true;
+        } else if (strcmp(argv[i], "--occlusion-benchmark") == 0 && i + 1 < argc) {
+            occlusion_benchmark = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--deferred") == 0) {
+            deferred_shading = true;
+        } else if (strcmp(argv[i], "--clustered") == 0) {
+            clustered_shading = true;
+        } else if (strcmp(argv[i], "--cpu-binning") == 0) {
+            cpu_binning = true;
+        } else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+            light_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shadows") == 0 && i + 1 < argc) {
+            shadow_lights = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--depth-prepass") == 0 && i + 1 < argc) {
+            i++;
+            
+            if (strcmp(argv[i], "on") == 0) {
+                depth_prepass = RenderQueue::prepassOn;
+            } else if (strcmp(argv[i], "off") == 0) {
+                depth_prepass = RenderQueue::prepassOff;
+            } else if (strcmp(argv[i], "auto") == 0) {
+                depth_prepass = RenderQueue::prepassAuto;
+            } else {
+                std::cout << "[ERROR] --depth-prepass takes on, off or auto" << std::endl;
+            }
+        } else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+            i++;
+            
+            if (strcmp(argv[i], "sphere") == 0) {
+                sphere_mesh = true;
+            } else if (strcmp(argv[i], "cube") != 0) {
+                std::cout << "[ERROR] --mesh takes cube or sphere" << std::endl;
+            }
+        } else if (strcmp(argv[i], "--lod-threshold") == 0 && i + 1 < argc) {
+            lod_threshold = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc) {
+            resolution_budget = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--swap-interval") == 0 && i + 1 < argc) {
+            swap_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--frame-limit") == 0 && i + 1 < argc) {
+            frame_limit = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+            frames_in_flight = std::max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--hdr") == 0) {
+            hdr = true;
+        } else if (strcmp(argv[i], "--bloom") == 0 && i + 1 < argc) {
+            bloom_strength = std::max((float)atof(argv[++i]), 0.0f);
+        } else if (strcmp(argv[i], "--single-thread") == 0) {
+            single_thread = true;
+        } else if (strcmp(argv[i], "--upscale") == 0 && i + 1 < argc) {
+            i++;
+            
+            if (strcmp(argv[i], "bilinear") == 0) {
+                upscale = DynamicResolution::bilinear;
+            } else if (strcmp(argv[i], "sharpen") == 0) {
+                upscale = DynamicResolution::sharpen;
+            } else {
+                std::cout << "[ERROR] --upscale takes bilinear or sharpen" << std::endl;
+            }
+        } else {
+            std::cout << "[ERROR] Unknown argument " << argv[i] << std::endl;
+        }
+    }
+}
+
+std::vector<Instance> build_stress_scene(unsigned int count) {
+    std::vector<Instance> instances;
+    instances.reserve(count);
+    
+    const float spacing = 1.5f;
+    int side = (int)std::ceil(std::cbrt((float)count));
+    glm::vec3 origin(-0.5f * side * spacing, -0.5f * side * spacing, -side * spacing);
+    
+    for (unsigned int i = 0; i < count; i++) {
+        glm::vec3 cell(i % side, (i / side) % side, i / (side * side));
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), origin + cell * spacing);
+        model = glm::rotate(model, glm::radians(7.0f * i), glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f)));
+        
+        glm::vec3 color = glm::vec3(0.3f) + 0.7f * cell / (float)side;
+        
+        instances.push_back(Instance(model, color));
+    }
+    
+    return instances;
+}
+
+// unit diameter UV sphere as the same interleaved triangle list as the cube, the poles share one texture coordinate
+std::vector<float> build_sphere(unsigned int rings, unsigned int segments) {
+    std::vector<float> vertices;
+    
+    auto vertex = [&](unsigned int ring, unsigned int segment) {
+        float theta = glm::pi<float>() * ring / rings;
+        float phi = 2.0f * glm::pi<float>() * segment / segments;
+        glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta), -std::sin(theta) * std::sin(phi));
+        float u = ring == 0 || ring == rings ? 0.5f : (float)segment / segments;
+        float data[] = { 0.5f * normal.x, 0.5f * normal.y, 0.5f * normal.z, normal.x, normal.y, normal.z, u, 1.0f - (float)ring / rings };
+        
+        vertices.insert(vertices.end(), data, data + 8);
+    };
+    
+    for (unsigned int ring = 0; ring < rings; ring++) {
+        for (unsigned int segment = 0; segment < segments; segment++) {
+            if (ring > 0) {
+                vertex(ring, segment);
+                vertex(ring + 1, segment);
+                vertex(ring, segment + 1);
+            }
+            
+            if (ring + 1 < rings) {
+                vertex(ring, segment + 1);
+                vertex(ring + 1, segment);
+                vertex(ring + 1, segment + 1);
+            }
+        }
+    }
+    
+    return vertices;
+}
+
+struct SceneObject {
+    glm::mat4 model;
+    glm::vec3 color;
+    Shader* program;
+};
+
+std::vector<SceneObject> build_object_scene(unsigned int count, Shader* phong, Shader* gouraud) {
+    std::vector<Instance> instances = build_stress_scene(count);
+    std::vector<SceneObject> objects;
+    
+    // interleave the programs so submission order alone would switch program on every draw
+    for (unsigned int i = 0; i < count; i++) {
+        objects.push_back({ instances[i].model, glm::vec3(instances[i].color), i % 2 ? gouraud : phong });
+    }
+    
+    return objects;
+}
+
+std::vector<glm::vec4> bounding_spheres(const std::vector<Instance>& instances, const glm::vec4& bounds) {
+    std::vector<glm::vec4> spheres;
+    
+    for (const Instance& instance : instances) {
+        glm::vec3 center(instance.model * glm::vec4(glm::vec3(bounds), 1.0f));
+        float scale = std::max(glm::length(instance.model[0]), std::max(glm::length(instance.model[1]), glm::length(instance.model[2])));
+        
+        spheres.push_back(glm::vec4(center, bounds.w * scale));
+    }
+    
+    return spheres;
+}
+
+// the nearest objects in view occlude the rest
+void select_occluders(const std::vector<glm::vec4>& spheres, const glm::mat4& view, const glm::mat4& projection, unsigned int count, std::vector<unsigned int>& occluders) {
+    Frustum frustum(projection * view);
+    std::vector<std::pair<float, unsigned int>> candidates;
+    
+    for (unsigned int i = 0; i < spheres.size(); i++) {
+        if (frustum.intersects(glm::vec3(spheres[i]), spheres[i].w)) {
+            candidates.push_back({ -(view * glm::vec4(glm::vec3(spheres[i]), 1.0f)).z, i });
+        }
+    }
+    
+    count = std::min(count, (unsigned int)candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+    
+    occluders.clear();
+    
+    for (unsigned int i = 0; i < count; i++) occluders.push_back(candidates[i].second);
+}
+
+// CPU occlusion culling of a stress scene from the start camera, no window or GL needed
+void run_occlusion_benchmark(unsigned int count) {
+    const unsigned int occluderCount = 32;
+    const int iterations = 100;
+    
+    std::vector<Instance> instances = build_stress_scene(count);
+    std::vector<glm::vec4> spheres = bounding_spheres(instances, glm::vec4(0.0f, 0.0f, 0.0f, 0.5f * std::sqrt(3.0f)));
+    SoftwareOcclusion::Occluder cubeOccluder = SoftwareOcclusion::box(glm::vec3(-0.5f), glm::vec3(0.5f));
+    std::vector<unsigned int> occluders;
+    std::vector<unsigned char> visible;
+    
+    ThreadPool threadPool;
+    SoftwareOcclusion occlusion(threadPool);
+    
+    glm::mat4 view = camera.view();
+    glm::mat4 projection = glm::perspective(glm::radians(fov), (float)width / (float)height, near_plane, far_plane);
+    float rasterTime = 0.0f;
+    float testTime = 0.0f;
+    
+    for (int i = 0; i < iterations; i++) {
+        select_occluders(spheres, view, projection, occluderCount, occluders);
+        
+        occlusion.begin(view, projection);
+        
+        for (unsigned int occluder : occluders) occlusion.addOccluder(cubeOccluder, instances[occluder].model);
+        
+        occlusion.rasterize();
+        occlusion.test(spheres, visible);
+        
+        rasterTime += occlusion.stats().rasterTime;
+        testTime += occlusion.stats().testTime;
+    }
+    
+    SoftwareOcclusion::Stats stats = occlusion.stats();
+    
+    std::cout << "[INFO] Occlusion benchmark: " << occluders.size() << " occluders (" << stats.triangles << " triangles), "
+              << stats.culled << " of " << stats.tested << " occludees hidden, " << threadPool.threadCount() << " threads" << std::endl;
+    std::cout << "[INFO] Occlusion benchmark: rasterize " << rasterTime / iterations << " ms, test " << testTime / iterations << " ms" << std::endl;
+}
+
+float random_unit() {
+    return (float)rand() / (float)RAND_MAX;
+}
+
+// light 0 is the orbiting scene light, the rest are scattered through the bounds of the scene
+std::vector<Light> build_lights(unsigned int count, const glm::vec3& center, float extent) {
+    std::vector<Light> lights;
+    
+    if (count == 0) return lights;
+    
+    lights.push_back({ glm::vec3(0.0f), far_plane, glm::vec3(1.0f), 1.0f, -1 });
+    
+    srand(1);
+    
+    for (unsigned int i = 1; i < count; i++) {
+        glm::vec3 offset(random_unit(), random_unit(), random_unit());
+        glm::vec3 color(random_unit(), random_unit(), random_unit());
+        
+        color /= std::max(color.r, std::max(color.g, color.b));
+        
+        lights.push_back({ center + (2.0f * offset - 1.0f) * extent, 2.0f + 3.0f * random_unit(), color, 0.5f, -1 });
+    }
+    
+    return lights;
+}
+
 int main(int argc, const char * argv[]) {
+    parse_args(argc, argv);
+    
+    if (occlusion_benchmark > 0) {
+        run_occlusion_benchmark(occlusion_benchmark);
+        return 0;
+    }
+    
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     
-    GLFWwindow* window = glfwCreateWindow(width, height, "LearnOpenGL", NULL, NULL);
+    // newest first, so the GPU driven path gets a 4.3+ context where the driver has one
+    const int versions[][2] = { { 4, 5 }, { 4, 3 }, { 3, 3 } };
+    GLFWwindow* window = NULL;
+    
+    for (const auto& version : versions) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        
+        window = glfwCreateWindow(width, height, "LearnOpenGL", NULL, NULL);
+        
+        if (window != NULL) break;
+    }
     
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -144,8 +467,13 @@ int main(int argc, const char * argv[]) {
         return -2;
     }
     
+    GLExtensions::load((GLADloadproc)glfwGetProcAddress);
+    
+    // left to the driver the swap interval is anyone's guess, 0 turns vsync off
+    glfwSwapInterval(swap_interval);
+    
     glViewport(0, 0, width, height);
-    glEnable(GL_DEPTH_TEST);
+    GLState::setDepthTest(true);
     
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_pos_callback);
@@ -200,32 +528,237 @@ int main(int argc, const char * argv[]) {
     glm::vec3 cubePosition(0.0f,  0.0f, 0.0f);
     glm::vec3 lightPosition(1.2f, 0.0f, 2.0f);
     
-    unsigned int VAO, VBO, lightVAO;
+    Mesh cube(vertices, sizeof(vertices) / (8 * sizeof(float)), VertexFormat::compact());
+    
+    // the scene is drawn with one mesh, light markers stay cubes
+    std::unique_ptr<Mesh> sphere;
+    
+    if (sphere_mesh) {
+        std::vector<float> sphereVertices = build_sphere(32, 64);
+        sphere.reset(new Mesh(sphereVertices.data(), (unsigned int)sphereVertices.size() / 8, VertexFormat::compact()));
+    }
+    
+    Mesh& sceneMesh = sphere ? *sphere : cube;
     
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    Shader cubeProgram("./shaders/cube-vs.glsl", "./shaders/cube-fs.glsl");
+    Shader lightProgram("./shaders/light-vs.glsl", "./shaders/light-fs.glsl");
+    Shader gouraudProgram("./shaders/cube-gouraud-vs.glsl", "./shaders/cube-gouraud-fs.glsl");
     
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    Shader* programs[] = { &cubeProgram, &lightProgram, &gouraudProgram };
     
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    for (Shader* program : programs) {
+        program->bindUniformBlock("Frame", FrameUniforms::binding);
+        program->bindUniformBlock("Object", ObjectUniforms::binding);
+    }
     
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    ThreadPool threadPool;
+    // the scheduler keeps the GPU at most this many frames behind, so that many regions are never waited on
+    FrameScheduler frameScheduler(frames_in_flight);
+    std::vector<SceneObject> objects;
     
-    glGenVertexArrays(1, &lightVAO);
-    glBindVertexArray(lightVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (scene_objects > 0) {
+        objects = build_object_scene(scene_objects, &cubeProgram, &gouraudProgram);
+    } else {
+        objects.push_back({ glm::translate(glm::mat4(1.0f), cubePosition), glm::vec3(1.0f, 0.5f, 0.31f), &cubeProgram });
+    }
     
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    // each object takes a uniform range for its draw and one for its occlusion box at most, the frame and cluster
+    // uniforms come on top; the region never shrinks below what smaller scenes always had
+    GLint uniform_alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
     
-    Shader cubeProgram("./shaders/cube-vs.glsl", "./shaders/cube-fs.glsl");
-    Shader lightProgram("./shaders/light-vs.glsl", "./shaders/light-fs.glsl");
+    GLsizeiptr object_stride = (sizeof(ObjectUniforms) + uniform_alignment - 1) / uniform_alignment * uniform_alignment;
+    GLsizeiptr uniform_frame_size = 2 * object_stride * objects.size() + sizeof(FrameUniforms) + sizeof(ClusterUniforms) + 2 * uniform_alignment;
     
-    while (!glfwWindowShouldClose(window)) {
+    StreamBuffer uniformStream(GL_UNIFORM_BUFFER, std::max<GLsizeiptr>(uniform_frame_size, 4 * 1024 * 1024), frames_in_flight);
+    RenderQueue renderQueue(far_plane, threadPool);
+    renderQueue.setDepthPrepass(depth_prepass);
+    
+    float last_report = 0.0f;
+    LightGrid lightGrid;
+    
+    unsigned int scene_size = std::max(stress_instances, scene_objects);
+    float scene_extent = 2.0f;
+    glm::vec3 scene_center = cubePosition;
+    
+    if (scene_size > 0) {
+        // matches the grid of build_stress_scene
+        const float spacing = 1.5f;
+        int side = (int)std::ceil(std::cbrt((float)scene_size));
+        
+        scene_extent = 0.5f * side * spacing;
+        scene_center = glm::vec3(-0.5f * spacing, -0.5f * spacing, -scene_extent - 0.5f * spacing);
+    }
+    
+    std::vector<Light> lights = build_lights(light_count, scene_center, scene_extent);
+    
+    // the first lights cast shadows, light 0 is the only one that moves so the others keep their maps
+    std::unique_ptr<ShadowMaps> shadowMaps;
+    // instances shaded forward only see the orbiting light and never sample the atlas, rendering it would be wasted
+    bool shadows_sampled = stress_instances == 0 || deferred_shading || clustered_shading;
+    
+    if (shadow_lights > 0 && !lights.empty() && !shadows_sampled) {
+        std::cout << "[ERROR] Shadows with --instances need --deferred or --clustered, leaving them off" << std::endl;
+    } else if (shadow_lights > 0 && !lights.empty()) {
+        shadowMaps.reset(new ShadowMaps(sceneMesh, std::min(shadow_lights, (unsigned int)lights.size())));
+        
+        for (unsigned int i = 0; i < shadowMaps->count(); i++) lights[i].shadowMap = i;
+        
+        if (stress_instances == 0) {
+            std::vector<Instance> casters;
+            
+            for (const SceneObject& object : objects) casters.push_back(Instance(object.model, object.color));
+            
+            shadowMaps->setCasters(casters);
+        }
+        
+        std::cout << "[INFO] Shadows: " << shadowMaps->count() << " point lights sharing one atlas" << std::endl;
+    }
+    
+    // the shading path decides what the scene is drawn with, without a scene program objects keep their own
+    std::unique_ptr<Shader> sceneProgram;
+    const char* instancedFragmentPath = "./shaders/cube-instanced-fs.glsl";
+    
+    std::unique_ptr<DeferredLighting> deferredLighting;
+    std::unique_ptr<ClusteredLighting> clusteredLighting;
+    
+    if (deferred_shading) {
+        sceneProgram.reset(new Shader("./shaders/cube-vs.glsl", "./shaders/gbuffer-fs.glsl"));
+        instancedFragmentPath = "./shaders/gbuffer-instanced-fs.glsl";
+        
+        deferredLighting.reset(new DeferredLighting());
+        std::cout << "[INFO] Deferred shading: " << lights.size() << " lights" << std::endl;
+    } else if (clustered_shading) {
+        sceneProgram.reset(new Shader("./shaders/cube-vs.glsl", "./shaders/cube-clustered-fs.glsl"));
+        instancedFragmentPath = "./shaders/cube-clustered-instanced-fs.glsl";
+        
+        clusteredLighting.reset(new ClusteredLighting(near_plane, far_plane, threadPool, cpu_binning));
+        std::cout << "[INFO] Clustered forward shading: " << lights.size() << " lights" << std::endl;
+    } else if (lights.size() > 1) {
+        std::cout << "[INFO] Forward shading: the strongest " << ObjectUniforms::maxLights << " of " << lights.size() << " lights per object" << std::endl;
+    }
+    
+    Shader instancedProgram("./shaders/cube-instanced-vs.glsl", instancedFragmentPath);
+    
+    InstanceBatch sceneBatch(sceneMesh);
+    InstanceBatch lightBatch(cube);
+    std::unique_ptr<Shader> indirectProgram;
+    std::unique_ptr<GpuCuller> gpuCuller;
+    std::unique_ptr<HiZBuffer> hiZ;
+    
+    if (gpu_culling && !GLExtensions::gpuDriven) {
+        std::cout << "[ERROR] GPU culling needs OpenGL 4.3, using the instanced path" << std::endl;
+    } else if (gpu_culling) {
+        indirectProgram.reset(new Shader("./shaders/cube-indirect-vs.glsl", instancedFragmentPath));
+        gpuCuller.reset(new GpuCuller(sceneMesh));
+        gpuCuller->setLodThreshold(lod_threshold);
+        
+        if (hiz_culling) hiZ.reset(new HiZBuffer());
+    }
+    
+    if (hiz_culling && !gpu_culling) {
+        std::cout << "[ERROR] --hiz-culling only works together with --gpu-culling" << std::endl;
+    }
+    
+    Shader* scenePrograms[] = { sceneProgram.get(), &instancedProgram, indirectProgram.get() };
+    
+    for (Shader* program : scenePrograms) {
+        if (program == NULL) continue;
+        
+        program->bindUniformBlock("Frame", FrameUniforms::binding);
+        program->bindUniformBlock("Object", ObjectUniforms::binding);
+        
+        if (clusteredLighting) clusteredLighting->setSamplers(*program);
+        
+        ShadowMaps::setSamplers(*program);
+    }
+    
+    ShadowMaps::setSamplers(cubeProgram);
+    
+    // objects never move, their bounds are computed once
+    std::unique_ptr<SoftwareOcclusion> softwareOcclusion;
+    std::unique_ptr<OcclusionQueries> occlusionQueries;
+    // a sphere only occludes with the box inside it
+    float occluderExtent = sphere ? 0.25f : 0.5f;
+    SoftwareOcclusion::Occluder occluderBox = SoftwareOcclusion::box(glm::vec3(-occluderExtent), glm::vec3(occluderExtent));
+    std::unique_ptr<LodSelector> lodSelector;
+    std::vector<glm::vec4> objectSpheres;
+    std::vector<unsigned char> objectVisible;
+    std::vector<unsigned int> occluders;
+    const unsigned int occluderCount = 32;
+    
+    if ((cpu_occlusion || occlusion_queries) && stress_instances > 0) {
+        std::cout << "[ERROR] Occlusion culling works on scene objects, not stress instances" << std::endl;
+    } else {
+        std::vector<Instance> objectInstances;
+        
+        for (const SceneObject& object : objects) objectInstances.push_back(Instance(object.model, object.color));
+        
+        objectSpheres = bounding_spheres(objectInstances, sceneMesh.boundingSphere());
+        
+        if (sceneMesh.lodCount() > 1 && lod_threshold > 0.0f) {
+            lodSelector.reset(new LodSelector((unsigned int)objects.size(), lod_threshold));
+            std::cout << "[INFO] Levels of detail: chosen per object for an error under " << lod_threshold << " pixels" << std::endl;
+        }
+        
+        if (cpu_occlusion) {
+            softwareOcclusion.reset(new SoftwareOcclusion(threadPool));
+            std::cout << "[INFO] CPU occlusion culling: the nearest " << occluderCount << " objects occlude the rest" << std::endl;
+        }
+        
+        if (occlusion_queries) {
+            occlusionQueries.reset(new OcclusionQueries((unsigned int)objects.size()));
+            std::cout << "[INFO] Occlusion queries: one per object, results read a frame late" << std::endl;
+        }
+    }
+    
+    std::unique_ptr<DynamicResolution> dynamicResolution;
+    
+    if (resolution_budget > 0.0f) {
+        dynamicResolution.reset(new DynamicResolution(resolution_budget, upscale));
+        std::cout << "[INFO] Dynamic resolution: scaling the scene to hold " << resolution_budget << " ms of GPU time per frame" << std::endl;
+    }
+    
+    std::unique_ptr<PostProcess> postProcess;
+    
+    if (hdr) {
+        postProcess.reset(new PostProcess(bloom_strength));
+        std::cout << "[INFO] HDR: tone mapped, bloom of strength " << bloom_strength << " at half and quarter resolution, downsampled "
+                  << (GLExtensions::gpuDriven ? "in one compute pass" : "in fragment passes") << std::endl;
+    }
+    
+    // the passes of a frame are declared anew every frame, the textures behind them are pooled
+    FrameGraph frameGraph;
+    FramePacer framePacer(frame_limit);
+    
+    // the render thread waits for the GPU after the main thread has already sampled the frame it takes next
+    unsigned int input_latency = frames_in_flight + (single_thread ? 0 : 1);
+    
+    std::cout << "[INFO] Frame pacing: swap interval " << swap_interval << ", at most " << frames_in_flight << " frames in flight, input up to "
+              << input_latency << " frames old";
+    
+    if (frame_limit > 0.0f) std::cout << ", limited to " << frame_limit << " frames per second";
+    
+    std::cout << std::endl;
+    
+    if (stress_instances > 0) {
+        std::vector<Instance> instances = build_stress_scene(stress_instances);
+        
+        if (shadowMaps) shadowMaps->setCasters(instances);
+        
+        if (gpuCuller) {
+            gpuCuller->setInstances(instances);
+            std::cout << "[INFO] Stress scene: " << instances.size() << " cubes culled on the GPU, 1 multi draw indirect call" << std::endl;
+        } else {
+            sceneBatch.update(instances);
+            std::cout << "[INFO] Stress scene: " << instances.size() << " cubes in 1 instanced draw call" << std::endl;
+        }
+    }
+    
+    FrameQueue frameQueue;
+    
+    // input, camera and the light orbit, always on the main thread; the render side only ever sees the packets
+    auto simulate_frame = [&](FramePacket& packet) {
         process_input(window);
         
         float time = glfwGetTime();
@@ -241,47 +774,362 @@ int main(int argc, const char * argv[]) {
         glm::mat4 l_rotateMat = glm::rotate(glm::mat4(1.0f), glm::radians(l_angle), glm::vec3(0.0f, 1.0f, 0.0f));
         glm::vec3 l_rotatedRadiusVec(l_rotateMat * glm::vec4(l_radiusVec, 1.0f));
         lightPosition = cubePosition + l_rotatedRadiusVec;
-
-        glClearColor(0.14f, 0.14f, 0.14f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glm::mat4 view = camera.view();
         
-        glm::mat4 projection = glm::mat4(1.0f);
-        projection = glm::perspective(glm::radians(fov), (float)width / (float)height, 0.1f, 100.0f);
+        if (!lights.empty()) lights[0].position = lightPosition;
+        
+        packet.time = time;
+        packet.width = width;
+        packet.height = height;
+        packet.view = camera.view();
+        packet.projection = glm::perspective(glm::radians(fov), (float)width / (float)height, near_plane, far_plane);
+        packet.viewPosition = camera.getPosition();
+        packet.lightPosition = lightPosition;
+        packet.lights = lights;
+        packet.lightMarkers.clear();
         
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, cubePosition);
+        for (unsigned int i = 0; i < lights.size(); i++) {
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, lights[i].position);
+            model = glm::scale(model, glm::vec3(i == 0 ? 0.2f : 0.1f));
+            
+            packet.lightMarkers.push_back(Instance(model, lights[i].color));
+        }
         
-        cubeProgram.use();
+        packet.last = false;
+    };
+    
+    // everything GL of a frame, on the render thread unless --single-thread
+    auto render_frame = [&](const FramePacket& packet) {
+        const std::vector<Light>& lights = packet.lights;
+        const glm::mat4& view = packet.view;
+        const glm::mat4& projection = packet.projection;
         
-        cubeProgram.setValue("view", view);
-        cubeProgram.setValue("projection", projection);
-        cubeProgram.setValue("model", model);
-        cubeProgram.setValue("objectColor", glm::vec3(1.0f, 0.5f, 0.31f));
-        cubeProgram.setValue("lightColor", glm::vec3(1.0f));
-        cubeProgram.setValue("lightPos", lightPosition);
-        cubeProgram.setValue("viewPos", camera.getPosition());
+        framePacer.beginFrame();
         
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        if (dynamicResolution) dynamicResolution->beginFrame(packet.width, packet.height);
         
-        lightProgram.use();
+        // the scene renders at the scaled size, the window gets it scaled up at the end of the frame
+        int render_width = dynamicResolution ? dynamicResolution->width() : packet.width;
+        int render_height = dynamicResolution ? dynamicResolution->height() : packet.height;
         
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, lightPosition);
-        model = glm::scale(model, glm::vec3(0.2f));
+        // for level of detail, what a unit facing the camera at distance 1 covers on screen
+        float pixels_per_unit = 0.5f * render_height * projection[1][1];
         
-        lightProgram.setValue("view", view);
-        lightProgram.setValue("projection", projection);
-        lightProgram.setValue("model", model);
+        GLState::resetStats();
+        renderQueue.resetStats();
         
-        glBindVertexArray(lightVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        frameGraph.reset();
         
-        glfwPollEvents();
+        FrameGraph::Resource backbuffer = frameGraph.importFramebuffer("backbuffer", 0, packet.width, packet.height);
+        // without dynamic resolution or HDR the scene goes straight to the window
+        FrameGraph::Resource sceneColor = backbuffer;
+        FrameGraph::Resource sceneDepth = backbuffer;
+        GBuffer gbuffer;
+        
+        // the first pass writing the scene target creates it
+        auto writeSceneTarget = [&](FrameGraph::Builder& builder) {
+            if ((dynamicResolution || postProcess) && sceneColor == backbuffer) {
+                sceneColor = builder.create("scene color", { render_width, render_height, postProcess ? PostProcess::hdrFormat : GL_RGBA8 });
+                sceneDepth = builder.create("scene depth", { render_width, render_height, GL_DEPTH_COMPONENT24 });
+            }
+            
+            builder.write(sceneColor);
+            builder.write(sceneDepth);
+        };
+        
+        if (shadowMaps) {
+            frameGraph.addPass("shadows", [&](FrameGraph::Builder& builder) {
+                // the atlas outlives the frame, nothing in the graph reads it
+                builder.sideEffect();
+            }, [&]() {
+                shadowMaps->update(lights, view, projection, render_height);
+                shadowMaps->bindTextures();
+            });
+        }
+        
+        frameGraph.addPass("scene", [&](FrameGraph::Builder& builder) {
+            if (deferred_shading) {
+                gbuffer.create(builder, render_width, render_height);
+            } else {
+                writeSceneTarget(builder);
+            }
+        }, [&]() {
+            glClearColor(0.14f, 0.14f, 0.14f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            
+            if (clusteredLighting) {
+                clusteredLighting->update(lights, view, projection, render_width, render_height, uniformStream);
+                clusteredLighting->bindTextures();
+            }
+            
+            if (stress_instances > 0 && gpuCuller) {
+                gpuCuller->cull(projection * view, packet.viewPosition, pixels_per_unit, hiZ.get());
+                
+                indirectProgram->use();
+                gpuCuller->draw();
+                
+                if (hiZ) {
+                    hiZ->build(render_width, render_height);
+                    gpuCuller->cullOccluded(*hiZ);
+                    
+                    indirectProgram->use();
+                    gpuCuller->drawOccluded();
+                }
+            } else if (stress_instances > 0) {
+                instancedProgram.use();
+                sceneBatch.draw();
+            } else {
+                // plain forward shading pays per draw for the strongest lights that reach the object only
+                if (!sceneProgram) lightGrid.build(lights);
+                
+                glm::vec4 bounds = sceneMesh.boundingSphere();
+                Light objectLights[ObjectUniforms::maxLights];
+                
+                if (softwareOcclusion) {
+                    select_occluders(objectSpheres, view, projection, occluderCount, occluders);
+                    
+                    softwareOcclusion->begin(view, projection);
+                    
+                    for (unsigned int occluder : occluders) softwareOcclusion->addOccluder(occluderBox, objects[occluder].model);
+                    
+                    softwareOcclusion->rasterize();
+                    softwareOcclusion->test(objectSpheres, objectVisible);
+                }
+                
+                if (occlusionQueries) occlusionQueries->beginFrame(packet.viewPosition, near_plane);
+                if (lodSelector) lodSelector->beginFrame(packet.viewPosition, pixels_per_unit);
+                
+                for (unsigned int i = 0; i < objects.size(); i++) {
+                    if (softwareOcclusion && !objectVisible[i]) continue;
+                    
+                    const SceneObject& object = objects[i];
+                    float depth = -(view * object.model[3]).z;
+                    Shader* program = sceneProgram ? sceneProgram.get() : object.program;
+                    float scale = std::max(glm::length(object.model[0]), std::max(glm::length(object.model[1]), glm::length(object.model[2])));
+                    unsigned int lightCount = 0;
+                    
+                    if (!sceneProgram) {
+                        glm::vec3 center(object.model * glm::vec4(glm::vec3(bounds), 1.0f));
+                        
+                        lightCount = lightGrid.select(center, bounds.w * scale, objectLights, ObjectUniforms::maxLights);
+                    }
+                    
+                    unsigned int lod = lodSelector ? lodSelector->select(i, sceneMesh, objectSpheres[i], scale) : 0;
+                    RenderQueue::Query query = { 0, RenderQueue::occlusionNone, glm::vec4(0.0f) };
+                    
+                    if (occlusionQueries) query = occlusionQueries->query(i, objectSpheres[i]);
+                    
+                    renderQueue.push(RenderQueue::opaque, program, &sceneMesh, NULL, object.model, object.color, depth, objectLights, lightCount, &query, lod);
+                }
+            }
+            
+            renderQueue.submit(uniformStream);
+        });
+        
+        if (deferred_shading) {
+            frameGraph.addPass("lighting", [&](FrameGraph::Builder& builder) {
+                gbuffer.read(builder);
+                writeSceneTarget(builder);
+            }, [&]() {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                
+                deferredLighting->render(frameGraph, gbuffer, lights, projection, glm::vec3(0.2f));
+            });
+        }
+        
+        frameGraph.addPass("light markers", [&](FrameGraph::Builder& builder) {
+            builder.read(sceneDepth);
+            writeSceneTarget(builder);
+        }, [&]() {
+            lightBatch.update(packet.lightMarkers);
+            lightProgram.use();
+            lightBatch.draw();
+        });
+        
+        // what the window gets, scaled up first with dynamic resolution
+        FrameGraph::Resource displayColor = sceneColor;
+        
+        if (postProcess) displayColor = postProcess->addPasses(frameGraph, sceneColor, dynamicResolution ? FrameGraph::none : backbuffer);
+        
+        if (dynamicResolution) {
+            frameGraph.addPass("upscale", [&](FrameGraph::Builder& builder) {
+                builder.read(displayColor);
+                builder.write(backbuffer);
+            }, [&]() {
+                dynamicResolution->upscale(frameGraph.texture(displayColor));
+            });
+        }
+        
+        uniformStream.beginFrame();
+        
+        StreamBuffer::Allocation frameAllocation = uniformStream.allocate(sizeof(FrameUniforms));
+        FrameUniforms* frame = (FrameUniforms*)frameAllocation.data;
+        
+        frame->view = view;
+        frame->projection = projection;
+        frame->lightPos = glm::vec4(packet.lightPosition, 1.0f);
+        frame->lightColor = glm::vec4(1.0f);
+        frame->viewPos = glm::vec4(packet.viewPosition, 1.0f);
+        
+        uniformStream.commit(frameAllocation);
+        uniformStream.bindRange(FrameUniforms::binding, frameAllocation);
+        
+        frameGraph.compile();
+        frameGraph.execute();
+        
+        if (dynamicResolution) dynamicResolution->endFrame();
+        
+        uniformStream.endFrame();
+        
+        if (packet.time - last_report > 1.0f) {
+            RenderQueue::Stats stats = renderQueue.stats();
+            
+            std::cout << "[INFO] Render queue: " << stats.draws << " draws, " << stats.programChanges << " program, "
+                      << stats.vaoChanges << " VAO, " << stats.textureChanges << " texture changes, " << stats.lights << " object lights, recorded into "
+                      << stats.commandBuffers << " command buffers" << std::endl;
+            
+            if (stats.depthDraws > 0 || renderQueue.overdraw() > 0.0f) {
+                std::cout << "[INFO] Depth pre-pass: " << (renderQueue.depthPrepass() ? "on" : "off") << ", overdraw "
+                          << renderQueue.overdraw() << ", " << stats.depthDraws << " depth draws" << std::endl;
+            }
+            
+            if (stress_instances > 0 && gpuCuller) {
+                GpuCuller::Stats culling = gpuCuller->stats();
+                
+                std::cout << "[INFO] GPU culling: " << culling.visible + culling.disoccluded << " of " << stress_instances << " instances drawn, "
+                          << culling.disoccluded << " of them after the occlusion re-test, " << culling.triangles << " triangles" << std::endl;
+            }
+            
+            GLState::Stats state = GLState::stats();
+            
+            std::cout << "[INFO] GL state: " << state.issued << " issued, " << state.skipped << " skipped" << std::endl;
+            
+            if (clusteredLighting && clusteredLighting->binningTime() > 0.0f) {
+                std::cout << "[INFO] Light binning: " << clusteredLighting->visibleLights() << " lights in "
+                          << clusteredLighting->binningTime() << " ms" << std::endl;
+            }
+            
+            if (softwareOcclusion) {
+                SoftwareOcclusion::Stats occlusion = softwareOcclusion->stats();
+                
+                std::cout << "[INFO] CPU occlusion: " << occlusion.culled << " of " << occlusion.tested << " objects hidden, "
+                          << occlusion.triangles << " occluder triangles in " << occlusion.rasterTime << " ms, tests in " << occlusion.testTime << " ms" << std::endl;
+            }
+            
+            if (occlusionQueries) {
+                OcclusionQueries::Stats queries = occlusionQueries->stats();
+                
+                std::cout << "[INFO] Occlusion queries: " << queries.hidden << " of " << objects.size() << " objects hidden, "
+                          << queries.queries << " queries, " << stats.boxDraws << " bounding boxes drawn, " << queries.reused
+                          << " draws conditioned on a query still in flight" << std::endl;
+            }
+            
+            FramePacer::Stats pacing = framePacer.stats();
+            
+            std::cout << "[INFO] Frame pacing: CPU " << pacing.cpuTime << " ms, GPU " << pacing.gpuTime << " ms, presented every "
+                      << pacing.presentInterval << " ms (longest " << pacing.maxPresentInterval << " ms), limiter waited " << pacing.waitTime << " ms" << std::endl;
+            framePacer.resetStats();
+            
+            if (postProcess && pacing.gpuTime > 0.0f) {
+                std::cout << "[INFO] Post-processing: " << postProcess->gpuTime() << " ms on the GPU, "
+                          << 100.0f * postProcess->gpuTime() / pacing.gpuTime << "% of the frame" << std::endl;
+            }
+            
+            FrameScheduler::Stats scheduling = frameScheduler.stats();
+            
+            std::cout << "[INFO] Frames in flight: waited " << scheduling.waitTime << " ms per frame for the GPU (longest "
+                      << scheduling.maxWaitTime << " ms)" << std::endl;
+            frameScheduler.resetStats();
+            
+            FrameGraph::Stats graph = frameGraph.stats();
+            
+            std::cout << "[INFO] Frame graph: " << graph.passes - graph.culled << " of " << graph.passes << " passes run, " << graph.transients
+                      << " transient targets in " << graph.textures << " textures, peak " << graph.peakMemory / 1048576.0f << " MB ("
+                      << graph.unaliasedMemory / 1048576.0f << " MB without sharing)" << std::endl;
+            
+            if (dynamicResolution) {
+                std::cout << "[INFO] Dynamic resolution: " << render_width << "x" << render_height << " (scale " << dynamicResolution->scale()
+                          << "), GPU frame " << dynamicResolution->gpuTime() << " ms" << std::endl;
+            }
+            
+            if (lodSelector) {
+                LodSelector::Stats lods = lodSelector->stats();
+                
+                std::cout << "[INFO] Levels of detail: " << lods.triangles << " of " << lods.fullTriangles << " triangles, objects per level";
+                
+                for (unsigned int i = 0; i < sceneMesh.lodCount(); i++) std::cout << " " << lods.objects[i];
+                
+                std::cout << std::endl;
+            }
+            
+            if (shadowMaps) {
+                ShadowMaps::Stats shadows = shadowMaps->stats();
+                
+                std::cout << "[INFO] Shadow maps: " << shadows.rendered << " rendered, " << shadows.cached << " reused, "
+                          << shadows.evicted << " evicted, " << shadows.unshadowed << " without a tile" << std::endl;
+                shadowMaps->resetStats();
+            }
+            
+            if (!single_thread) {
+                FrameQueue::Stats queue = frameQueue.stats();
+                
+                std::cout << "[INFO] Render thread: the simulation waited " << queue.producerWait << " ms per frame for a free packet, rendering "
+                          << queue.consumerWait << " ms for a new one" << std::endl;
+                frameQueue.resetStats();
+            }
+            
+            last_report = packet.time;
+        }
+        
+        framePacer.endFrame();
         glfwSwapBuffers(window);
+        framePacer.presented();
+        frameScheduler.endFrame();
+    };
+    
+    if (single_thread) {
+        FramePacket packet;
+        
+        while (!glfwWindowShouldClose(window)) {
+            frameScheduler.beginFrame();
+            glfwPollEvents();
+            simulate_frame(packet);
+            render_frame(packet);
+        }
+        
+        return 0;
     }
     
+    std::cout << "[INFO] Render thread: owns the GL context, the simulation runs up to a frame ahead of it" << std::endl;
+    
+    // from here on the context belongs to the render thread, window events stay on the main thread
+    glfwMakeContextCurrent(NULL);
+    
+    std::thread renderThread([&]() {
+        glfwMakeContextCurrent(window);
+        
+        while (true) {
+            // the next packet is taken only once the GPU has room for another frame
+            frameScheduler.beginFrame();
+            
+            const FramePacket& packet = frameQueue.front();
+            
+            if (packet.last) break;
+            
+            render_frame(packet);
+            frameQueue.release();
+        }
+    });
+    
+    while (!glfwWindowShouldClose(window)) {
+        glfwPollEvents();
+        simulate_frame(frameQueue.acquire());
+        frameQueue.publish();
+    }
+    
+    frameQueue.acquire().last = true;
+    frameQueue.publish();
+    renderThread.join();
+    
     return 0;
 }
@@ -0,0 +1,21 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D source;
+// one texel along the blur axis, in texture coordinates
+uniform vec2 direction;
+
+void main()
+{
+    vec2 position = gl_FragCoord.xy / vec2(textureSize(source, 0));
+    
+    // 9 tap gaussian, neighbouring taps share one bilinear fetch
+    vec3 color = 0.2270270270f * texture(source, position).rgb;
+    
+    color += 0.3162162162f * texture(source, position + 1.3846153846f * direction).rgb;
+    color += 0.3162162162f * texture(source, position - 1.3846153846f * direction).rgb;
+    color += 0.0702702703f * texture(source, position + 3.2307692308f * direction).rgb;
+    color += 0.0702702703f * texture(source, position - 3.2307692308f * direction).rgb;
+    
+    FragColor = vec4(color, 1.0f);
+}
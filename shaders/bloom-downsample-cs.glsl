@@ -0,0 +1,60 @@
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (r11f_g11f_b10f, binding = 0) uniform writeonly image2D halfLevel;
+layout (r11f_g11f_b10f, binding = 1) uniform writeonly image2D quarterLevel;
+
+uniform sampler2D source;
+uniform float threshold;
+// width of the soft transition below the threshold
+uniform float knee;
+
+shared vec3 tile[8][8];
+
+vec3 prefilter(vec3 color)
+{
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - threshold + knee, 0.0f, 2.0f * knee);
+    
+    soft = soft * soft / (4.0f * knee + 0.0001f);
+    
+    return color * max(soft, brightness - threshold) / max(brightness, 0.0001f);
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    ivec2 halfSize = imageSize(halfLevel);
+    vec2 texelSize = 1.0f / vec2(textureSize(source, 0));
+    vec3 color = vec3(0.0f);
+    
+    if (texel.x < halfSize.x && texel.y < halfSize.y) {
+        // four bilinear taps on the corners of the 2x2 source block average the 4x4 texels around it
+        vec2 center = vec2(texel * 2 + 1) * texelSize;
+        
+        color += texture(source, center + vec2(-1.0f, -1.0f) * texelSize).rgb;
+        color += texture(source, center + vec2(1.0f, -1.0f) * texelSize).rgb;
+        color += texture(source, center + vec2(-1.0f, 1.0f) * texelSize).rgb;
+        color += texture(source, center + vec2(1.0f, 1.0f) * texelSize).rgb;
+        color = prefilter(0.25f * color);
+        
+        imageStore(halfLevel, texel, vec4(color, 1.0f));
+    }
+    
+    // the quarter level comes out of the same dispatch, from the half level texels the group keeps in shared memory
+    tile[local.y][local.x] = color;
+    barrier();
+    
+    if (local.x >= 4 || local.y >= 4) return;
+    
+    ivec2 quarterTexel = ivec2(gl_WorkGroupID.xy) * 4 + local;
+    ivec2 quarterSize = imageSize(quarterLevel);
+    
+    if (quarterTexel.x >= quarterSize.x || quarterTexel.y >= quarterSize.y) return;
+    
+    ivec2 first = local * 2;
+    vec3 sum = tile[first.y][first.x] + tile[first.y][first.x + 1] + tile[first.y + 1][first.x] + tile[first.y + 1][first.x + 1];
+    
+    imageStore(quarterLevel, quarterTexel, vec4(0.25f * sum, 1.0f));
+}
@@ -0,0 +1,37 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D source;
+// only the first level keeps just what lies above the threshold
+uniform int prefilter;
+uniform float threshold;
+// width of the soft transition below the threshold
+uniform float knee;
+
+vec3 prefilterColor(vec3 color)
+{
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - threshold + knee, 0.0f, 2.0f * knee);
+    
+    soft = soft * soft / (4.0f * knee + 0.0001f);
+    
+    return color * max(soft, brightness - threshold) / max(brightness, 0.0001f);
+}
+
+void main()
+{
+    vec2 texelSize = 1.0f / vec2(textureSize(source, 0));
+    // four bilinear taps on the corners of the 2x2 source block average the 4x4 texels around it
+    vec2 center = vec2(ivec2(gl_FragCoord.xy) * 2 + 1) * texelSize;
+    vec3 color = vec3(0.0f);
+    
+    color += texture(source, center + vec2(-1.0f, -1.0f) * texelSize).rgb;
+    color += texture(source, center + vec2(1.0f, -1.0f) * texelSize).rgb;
+    color += texture(source, center + vec2(-1.0f, 1.0f) * texelSize).rgb;
+    color += texture(source, center + vec2(1.0f, 1.0f) * texelSize).rgb;
+    color *= 0.25f;
+    
+    if (prefilter != 0) color = prefilterColor(color);
+    
+    FragColor = vec4(color, 1.0f);
+}
@@ -0,0 +1,88 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec3 LightPos;
+
+layout (std140) uniform Object {
+    mat4 model;
+    vec4 objectColor;
+    ivec4 lightCount;
+    vec4 objectLights[16];
+};
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 viewPos;
+};
+
+layout (std140) uniform Clusters {
+    uvec4 gridSize;
+    vec4 screenSize;
+    vec4 depthSlicing;
+    mat4 inverseProjection;
+};
+
+uniform samplerBuffer lights;
+uniform usamplerBuffer lightGrid;
+uniform usamplerBuffer lightIndices;
+
+#include "point-shadow.glsl"
+
+vec3 clusterLighting(vec3 fragPos, vec3 norm, float specularStrength)
+{
+    uvec3 cluster;
+    cluster.xy = uvec2(gl_FragCoord.xy / screenSize.xy * vec2(gridSize.xy));
+    cluster.z = uint(max(log(-fragPos.z) * depthSlicing.x + depthSlicing.y, 0.0));
+    cluster = min(cluster, gridSize.xyz - 1u);
+    
+    uvec2 range = texelFetch(lightGrid, int(cluster.x + gridSize.x * (cluster.y + gridSize.y * cluster.z))).rg;
+    vec3 viewDir = normalize(-fragPos);
+    vec3 result = vec3(0.0);
+    
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).r);
+        vec4 positionRadius = texelFetch(lights, 2 * light);
+        vec4 colorShadow = texelFetch(lights, 2 * light + 1);
+        vec3 lightColor = colorShadow.rgb;
+        
+        vec3 toLight = positionRadius.xyz - fragPos;
+        float distance = length(toLight);
+        
+        // smooth window so the light reaches exactly zero at its radius
+        float falloff = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = falloff * falloff;
+        
+        // diffuse
+        vec3 lightDir = toLight / distance;
+        float diff = max(dot(norm, lightDir), 0.0);
+        vec3 diffuse = diff * lightColor;
+        
+        vec3 reflectDir = reflect(-lightDir, norm);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+        vec3 specular = specularStrength * spec * lightColor;
+        
+        float shadow = pointShadow(int(colorShadow.a), -toLight, positionRadius.w, diff);
+        
+        result += attenuation * shadow * (diffuse + specular);
+    }
+    
+    return result;
+}
+
+void main()
+{
+    // ambient
+    float ambientStrength = 0.2;
+    vec3 ambient = vec3(ambientStrength);
+    
+    float specularStrength = 1;
+    vec3 lighting = clusterLighting(FragPos, normalize(Normal), specularStrength);
+    
+    vec3 result = (ambient + lighting) * objectColor.rgb;
+    FragColor = vec4(result, 1.0);
+}
@@ -5,27 +5,58 @@ in vec3 Normal;
 in vec3 FragPos;
 in vec3 LightPos;
   
-uniform vec3 lightColor;
-uniform vec3 objectColor;
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 viewPos;
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    vec4 objectColor;
+    ivec4 lightCount;
+    vec4 objectLights[16];
+};
+
+#include "point-shadow.glsl"
 
 void main()
 {
     // ambient
     float ambientStrength = 0.2;
-    vec3 ambient = ambientStrength * lightColor;
-      
-    // diffuse
-    vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(LightPos - FragPos);
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
+    vec3 ambient = ambientStrength * lightColor.rgb;
     
-    float specularStrength = 1;
+    vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(-FragPos);
-    vec3 reflectDir = reflect(-lightDir, norm);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = specularStrength * spec * lightColor;
+    float specularStrength = 1;
+    vec3 lighting = vec3(0.0);
+    
+    for (int i = 0; i < lightCount.x; i++) {
+        vec3 toLight = vec3(view * vec4(objectLights[2 * i].xyz, 1.0f)) - FragPos;
+        vec3 color = objectLights[2 * i + 1].rgb;
+        int shadowMap = int(objectLights[2 * i + 1].w);
+        float distance = length(toLight);
+        
+        // smooth window so the light reaches exactly zero at its radius
+        float falloff = clamp(1.0 - pow(distance / objectLights[2 * i].w, 4.0), 0.0, 1.0);
+        float attenuation = falloff * falloff;
+        
+        // diffuse
+        vec3 lightDir = toLight / distance;
+        float diff = max(dot(norm, lightDir), 0.0);
+        vec3 diffuse = diff * color;
+        
+        vec3 reflectDir = reflect(-lightDir, norm);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+        vec3 specular = specularStrength * spec * color;
+        
+        float shadow = pointShadow(shadowMap, -toLight, objectLights[2 * i].w, diff);
+        
+        lighting += attenuation * shadow * (diffuse + specular);
+    }
             
-    vec3 result = (ambient + diffuse + specular) * objectColor;
+    vec3 result = (ambient + lighting) * objectColor.rgb;
     FragColor = vec4(result, 1.0);
 }
@@ -3,9 +3,14 @@ out vec4 FragColor;
 
 in vec3 LightColor;
 
-uniform vec3 objectColor;
+layout (std140) uniform Object {
+    mat4 model;
+    vec4 objectColor;
+    ivec4 lightCount;
+    vec4 objectLights[16];
+};
 
 void main()
 {
-    FragColor = vec4(LightColor * objectColor, 1.0);
+    FragColor = vec4(LightColor * objectColor.rgb, 1.0);
 }
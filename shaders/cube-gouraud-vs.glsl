@@ -4,35 +4,60 @@ layout (location = 1) in vec3 aNormal;
 
 out vec3 LightColor;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform vec3 lightPos;
-uniform vec3 lightColor;
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 viewPos;
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    vec4 objectColor;
+    ivec4 lightCount;
+    vec4 objectLights[16];
+};
+
+// matches depth-vs for the GL_EQUAL shading pass after a depth pre-pass
+invariant gl_Position;
 
 void main()
 {
     vec3 fragPos = vec3(view * model * vec4(aPos, 1.0f));
     vec3 normal = mat3(transpose(inverse(view * model))) * aNormal;
-    vec3 lightPosView = vec3(view * vec4(lightPos, 1.0f));
     
     // ambient
     float ambientStrength = 0.2;
-    vec3 ambient = ambientStrength * lightColor;
-      
-    // diffuse
-    vec3 norm = normalize(normal);
-    vec3 lightDir = normalize(lightPosView - fragPos);
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
+    vec3 ambient = ambientStrength * lightColor.rgb;
     
-    float specularStrength = 1;
+    vec3 norm = normalize(normal);
     vec3 viewDir = normalize(-fragPos);
-    vec3 reflectDir = reflect(-lightDir, norm);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = specularStrength * spec * lightColor;
+    float specularStrength = 1;
+    vec3 lighting = vec3(0.0);
+    
+    for (int i = 0; i < lightCount.x; i++) {
+        vec3 toLight = vec3(view * vec4(objectLights[2 * i].xyz, 1.0f)) - fragPos;
+        vec3 color = objectLights[2 * i + 1].rgb;
+        float distance = length(toLight);
+        
+        // smooth window so the light reaches exactly zero at its radius
+        float falloff = clamp(1.0 - pow(distance / objectLights[2 * i].w, 4.0), 0.0, 1.0);
+        float attenuation = falloff * falloff;
+        
+        // diffuse
+        vec3 lightDir = toLight / distance;
+        float diff = max(dot(norm, lightDir), 0.0);
+        vec3 diffuse = diff * color;
+        
+        vec3 reflectDir = reflect(-lightDir, norm);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+        vec3 specular = specularStrength * spec * color;
+        
+        lighting += attenuation * (diffuse + specular);
+    }
     
-    LightColor = ambient + diffuse + specular;
+    LightColor = ambient + lighting;
     
     gl_Position = projection * vec4(fragPos, 1.0f);
 }
@@ -0,0 +1,40 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 11) in uint aInstanceIndex;
+
+struct Instance {
+    mat4 model;
+    vec4 normalMatrix[3];
+    vec4 color;
+};
+
+layout (std430, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 LightPos;
+out vec3 ObjectColor;
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 viewPos;
+};
+
+void main()
+{
+    Instance instance = instances[aInstanceIndex];
+    mat3 normalMatrix = mat3(instance.normalMatrix[0].xyz, instance.normalMatrix[1].xyz, instance.normalMatrix[2].xyz);
+    
+    FragPos = vec3(view * instance.model * vec4(aPos, 1.0f));
+    Normal = mat3(view) * normalMatrix * aNormal;
+    LightPos = vec3(view * vec4(lightPos.xyz, 1.0f));
+    ObjectColor = instance.color.rgb;
+    
+    gl_Position = projection * vec4(FragPos, 1.0f);
+}
@@ -0,0 +1,29 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in mat3x4 aNormalMatrix;
+layout (location = 10) in vec4 aColor;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 LightPos;
+out vec3 ObjectColor;
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 viewPos;
+};
+
+void main()
+{
+    FragPos = vec3(view * aModel * vec4(aPos, 1.0f));
+    Normal = mat3(view) * mat3(aNormalMatrix) * aNormal;
+    LightPos = vec3(view * vec4(lightPos.xyz, 1.0f));
+    ObjectColor = aColor.rgb;
+    
+    gl_Position = projection * vec4(FragPos, 1.0f);
+}
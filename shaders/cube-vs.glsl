@@ -6,16 +6,29 @@ out vec3 FragPos;
 out vec3 Normal;
 out vec3 LightPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform vec3 lightPos;
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 viewPos;
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    vec4 objectColor;
+    ivec4 lightCount;
+    vec4 objectLights[16];
+};
+
+// matches depth-vs for the GL_EQUAL shading pass after a depth pre-pass
+invariant gl_Position;
 
 void main()
 {
     FragPos = vec3(view * model * vec4(aPos, 1.0f));
     Normal = mat3(transpose(inverse(view * model))) * aNormal;
-    LightPos = vec3(view * vec4(lightPos, 1.0f));
+    LightPos = vec3(view * vec4(lightPos.xyz, 1.0f));
     
     gl_Position = projection * vec4(FragPos, 1.0f);
 }
@@ -0,0 +1,136 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+struct Instance {
+    mat4 model;
+    vec4 normalMatrix[3];
+    vec4 color;
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+layout (std430, binding = 1) writeonly buffer VisibleInstances {
+    uint visibleInstances[];
+};
+
+layout (std430, binding = 2) buffer DrawCommands {
+    DrawCommand commands[];
+};
+
+// set in phase 0 for instances only the occlusion test rejected, phase 1 tests them again
+layout (std430, binding = 3) buffer OccludedInstances {
+    uint occludedInstances[];
+};
+
+uniform vec4 frustumPlanes[6];
+uniform vec4 boundingSphere;
+uniform int instanceCount;
+uniform int phase;
+uniform bool occlusion;
+uniform mat4 viewProjection;
+uniform sampler2D hiZ;
+
+// level of detail of every instance, phase 0 picks it starting from the one of the previous frame
+layout (std430, binding = 4) buffer InstanceLevels {
+    uint instanceLevels[];
+};
+
+// commands per phase, and the coarsest level selection may pick
+uniform int lodCount;
+uniform int maxLevel;
+uniform vec4 lodErrors;
+uniform float lodHysteresis;
+uniform vec3 viewPosition;
+// pixels per unit at distance 1 over the error threshold in pixels
+uniform float lodScale;
+
+uint selectLevel(uint previous, vec3 center, float radius, float scale)
+{
+    float distance = max(length(center - viewPosition) - radius, 1e-4f);
+    float pixels = scale * lodScale / distance;
+    int level = min(int(previous), maxLevel);
+    
+    while (level > 0 && lodErrors[level] * pixels > 1.0f) level--;
+    while (level < maxLevel && lodErrors[level + 1] * pixels < lodHysteresis) level++;
+    
+    return uint(level);
+}
+
+bool occluded(vec3 center, float radius)
+{
+    vec3 ndcMin = vec3(1.0f);
+    vec3 ndcMax = vec3(-1.0f);
+    
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0f : -1.0f, (i & 2) != 0 ? 1.0f : -1.0f, (i & 4) != 0 ? 1.0f : -1.0f);
+        vec4 clip = viewProjection * vec4(corner, 1.0f);
+        
+        // the box reaches behind the camera, its projection has no bounds
+        if (clip.w <= 0.0f) return false;
+        
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+    
+    if (ndcMin.z < -1.0f) return false;
+    
+    ivec2 size = textureSize(hiZ, 0);
+    ivec2 first = min(ivec2(clamp(ndcMin.xy * 0.5f + 0.5f, 0.0f, 1.0f) * vec2(size)), size - 1);
+    ivec2 last = min(ivec2(clamp(ndcMax.xy * 0.5f + 0.5f, 0.0f, 1.0f) * vec2(size)), size - 1);
+    
+    // the level where the rectangle spans at most 2x2 texels
+    ivec2 extent = last - first;
+    int level = min(findMSB(max(extent.x, extent.y)) + 1, textureQueryLevels(hiZ) - 1);
+    ivec2 levelSize = max(size >> level, ivec2(1));
+    ivec2 a = min(first >> level, levelSize - 1);
+    ivec2 b = min(last >> level, levelSize - 1);
+    
+    float farthest = max(max(texelFetch(hiZ, a, level).r, texelFetch(hiZ, ivec2(b.x, a.y), level).r),
+                         max(texelFetch(hiZ, ivec2(a.x, b.y), level).r, texelFetch(hiZ, b, level).r));
+    
+    return ndcMin.z * 0.5f + 0.5f > farthest;
+}
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+    
+    if (index >= uint(instanceCount)) return;
+    
+    if (phase == 1 && occludedInstances[index] == 0u) return;
+    
+    mat4 model = instances[index].model;
+    vec3 center = vec3(model * vec4(boundingSphere.xyz, 1.0f));
+    float scale = max(max(length(model[0].xyz), length(model[1].xyz)), length(model[2].xyz));
+    float radius = boundingSphere.w * scale;
+    
+    if (phase == 0) {
+        occludedInstances[index] = 0u;
+        
+        for (int i = 0; i < 6; i++) {
+            if (dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w < -radius) return;
+        }
+        
+        instanceLevels[index] = selectLevel(instanceLevels[index], center, radius, scale);
+    }
+    
+    if (occlusion && occluded(center, radius)) {
+        occludedInstances[index] = 1u;
+        return;
+    }
+    
+    uint command = uint(phase * lodCount) + instanceLevels[index];
+    uint slot = atomicAdd(commands[command].instanceCount, 1u);
+    visibleInstances[commands[command].baseInstance + slot] = index;
+}
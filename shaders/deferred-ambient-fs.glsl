@@ -0,0 +1,19 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform vec3 ambient;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    
+    // background keeps the clear color and depth
+    if (depth == 1.0) discard;
+    
+    gl_FragDepth = depth;
+    FragColor = vec4(ambient * texelFetch(gAlbedo, texel, 0).rgb, 1.0);
+}
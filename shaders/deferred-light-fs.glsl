@@ -0,0 +1,69 @@
+#version 330 core
+out vec4 FragColor;
+
+flat in vec4 Light;
+flat in vec3 LightColor;
+flat in int ShadowMap;
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 viewPos;
+};
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+
+#include "point-shadow.glsl"
+
+vec3 decodeNormal(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+    
+    // volumes clamped to the far plane still pass the depth test over the background
+    if (depth == 1.0) discard;
+    
+    // view space position from the depth buffer
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(gDepth, 0));
+    vec4 clip = inverseProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = clip.xyz / clip.w;
+    
+    vec3 toLight = Light.xyz - fragPos;
+    float distance = length(toLight);
+    
+    if (distance > Light.w) discard;
+    
+    vec4 albedo = texelFetch(gAlbedo, texel, 0);
+    vec3 norm = decodeNormal(texelFetch(gNormal, texel, 0).rg);
+    
+    // smooth window so the light reaches exactly zero at its radius
+    float falloff = clamp(1.0 - pow(distance / Light.w, 4.0), 0.0, 1.0);
+    float attenuation = falloff * falloff;
+    
+    // diffuse
+    vec3 lightDir = toLight / distance;
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = diff * LightColor;
+    
+    vec3 viewDir = normalize(-fragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = albedo.a * spec * LightColor;
+    
+    float shadow = pointShadow(ShadowMap, -toLight, Light.w, diff);
+    
+    FragColor = vec4(attenuation * shadow * (diffuse + specular) * albedo.rgb, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in vec4 aLight;
+layout (location = 4) in vec4 aColor;
+layout (location = 5) in int aShadowMap;
+
+flat out vec4 Light;
+flat out vec3 LightColor;
+flat out int ShadowMap;
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 viewPos;
+};
+
+void main()
+{
+    Light = vec4(vec3(view * vec4(aLight.xyz, 1.0)), aLight.w);
+    LightColor = aColor.rgb * aColor.a;
+    ShadowMap = aShadowMap;
+    
+    gl_Position = projection * vec4(Light.xyz + aPos * aLight.w, 1.0);
+}
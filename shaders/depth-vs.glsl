@@ -0,0 +1,27 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 lightPos;
+    vec4 lightColor;
+    vec4 viewPos;
+};
+
+layout (std140) uniform Object {
+    mat4 model;
+    vec4 objectColor;
+    ivec4 lightCount;
+    vec4 objectLights[16];
+};
+
+// the shading pass tests GL_EQUAL against this depth, so the position math matches cube-vs exactly
+invariant gl_Position;
+
+void main()
+{
+    vec3 fragPos = vec3(view * model * vec4(aPos, 1.0f));
+    
+    gl_Position = projection * vec4(fragPos, 1.0f);
+}
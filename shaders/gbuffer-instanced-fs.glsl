@@ -0,0 +1,24 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec2 gNormal;
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec3 LightPos;
+in vec3 ObjectColor;
+
+// octahedral encoding, the unit sphere folded onto a square so two channels hold a normal
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
+
+void main()
+{
+    float specularStrength = 1;
+    
+    gAlbedo = vec4(ObjectColor, specularStrength);
+    gNormal = encodeNormal(normalize(Normal));
+}
@@ -0,0 +1,34 @@
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (r32f, binding = 0) uniform writeonly image2D destination;
+
+uniform sampler2D source;
+uniform int sourceLevel;
+uniform int scale;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(destination);
+    
+    if (texel.x >= size.x || texel.y >= size.y) return;
+    
+    ivec2 sourceSize = max(textureSize(source, 0) >> sourceLevel, ivec2(1));
+    ivec2 first = texel * scale;
+    ivec2 last = first + ivec2(scale);
+    
+    // the last row and column also take what an odd source size leaves over
+    if (texel.x == size.x - 1) last.x = sourceSize.x;
+    if (texel.y == size.y - 1) last.y = sourceSize.y;
+    
+    float depth = 0.0f;
+    
+    for (int y = first.y; y < last.y; y++) {
+        for (int x = first.x; x < last.x; x++) {
+            depth = max(depth, texelFetch(source, ivec2(x, y), sourceLevel).r);
+        }
+    }
+    
+    imageStore(destination, texel, vec4(depth));
+}
@@ -0,0 +1,101 @@
+#version 430 core
+layout (local_size_x = 128) in;
+
+layout (std140) uniform Clusters {
+    uvec4 gridSize;
+    vec4 screenSize;
+    vec4 depthSlicing;
+    mat4 inverseProjection;
+};
+
+// two vec4 per light: view space position and radius, color
+layout (std430, binding = 0) readonly buffer Lights {
+    vec4 lights[];
+};
+
+// offset and count into lightIndices for every cluster
+layout (std430, binding = 1) writeonly buffer LightGrid {
+    uvec2 grid[];
+};
+
+layout (std430, binding = 2) writeonly buffer LightIndices {
+    uint lightIndices[];
+};
+
+layout (std430, binding = 3) buffer Counter {
+    uint indexCount;
+};
+
+uniform int indexCapacity;
+
+const uint maxClusterLights = 256u;
+
+shared vec4 sharedLights[gl_WorkGroupSize.x];
+
+vec3 viewRay(vec2 pixel)
+{
+    vec4 point = inverseProjection * vec4(pixel / screenSize.xy * 2.0 - 1.0, -1.0, 1.0);
+    return point.xyz / point.w;
+}
+
+float sliceDepth(uint slice)
+{
+    return depthSlicing.z * pow(depthSlicing.w / depthSlicing.z, float(slice) / float(gridSize.z));
+}
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+    uvec3 cluster = uvec3(index % gridSize.x, (index / gridSize.x) % gridSize.y, index / (gridSize.x * gridSize.y));
+    
+    // view space bounds: the tile corners pushed along their rays to the near and far depth of the slice
+    vec2 tileSize = screenSize.xy / vec2(gridSize.xy);
+    vec3 rayMin = viewRay(vec2(cluster.xy) * tileSize);
+    vec3 rayMax = viewRay(vec2(cluster.xy + 1u) * tileSize);
+    float zNear = sliceDepth(cluster.z);
+    float zFar = sliceDepth(cluster.z + 1u);
+    
+    vec3 nearMin = rayMin * (zNear / -rayMin.z);
+    vec3 nearMax = rayMax * (zNear / -rayMax.z);
+    vec3 farMin = rayMin * (zFar / -rayMin.z);
+    vec3 farMax = rayMax * (zFar / -rayMax.z);
+    
+    vec3 aabbMin = min(min(nearMin, nearMax), min(farMin, farMax));
+    vec3 aabbMax = max(max(nearMin, nearMax), max(farMin, farMax));
+    
+    uint visible[maxClusterLights];
+    uint count = 0u;
+    uint lightCount = gridSize.w;
+    
+    // the group walks the lights in batches staged in shared memory, every invocation has to reach the barriers
+    for (uint base = 0u; base < lightCount; base += gl_WorkGroupSize.x) {
+        uint load = base + gl_LocalInvocationIndex;
+        
+        if (load < lightCount) sharedLights[gl_LocalInvocationIndex] = lights[2u * load];
+        
+        barrier();
+        
+        uint batch = min(gl_WorkGroupSize.x, lightCount - base);
+        
+        for (uint i = 0u; i < batch && count < maxClusterLights; i++) {
+            vec4 light = sharedLights[i];
+            vec3 closest = clamp(light.xyz, aabbMin, aabbMax) - light.xyz;
+            
+            if (dot(closest, closest) <= light.w * light.w) visible[count++] = base + i;
+        }
+        
+        barrier();
+    }
+    
+    if (index >= gridSize.x * gridSize.y * gridSize.z) return;
+    
+    uint offset = atomicAdd(indexCount, count);
+    uint capacity = uint(indexCapacity);
+    
+    count = offset < capacity ? min(count, capacity - offset) : 0u;
+    grid[index] = uvec2(offset, count);
+    
+    for (uint i = 0u; i < count; i++) {
+        lightIndices[offset + i] = visible[i];
+    }
+}
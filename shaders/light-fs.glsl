@@ -2,6 +2,8 @@
 
 out vec4 FragColor;
 
+in vec3 LightColor;
+
 void main() {
-    FragColor = vec4(1.0f);
+    FragColor = vec4(LightColor, 1.0f);
 }
@@ -0,0 +1,41 @@
+// point light shadows from the ShadowMaps atlas, included after the Frame block whose view matrix it reads
+
+uniform sampler2DShadow shadowAtlas;
+uniform samplerBuffer shadowTiles;
+
+// cube face bases of ShadowMaps: +x, -x, +y, -y, +z, -z
+const vec3 faceRight[6] = vec3[6](vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 0.0),
+                                  vec3(1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0));
+const vec3 faceUp[6] = vec3[6](vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0),
+                               vec3(0.0, 0.0, -1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0));
+
+// fraction of a point light reaching the surface, fromLight is the view space offset from the light
+float pointShadow(int shadowMap, vec3 fromLight, float radius, float cosTheta)
+{
+    if (shadowMap < 0) return 1.0;
+    
+    // atlas position and face size, no tile this frame means no shadow
+    vec4 tile = texelFetch(shadowTiles, shadowMap);
+    
+    if (tile.z == 0.0) return 1.0;
+    
+    vec3 direction = transpose(mat3(view)) * fromLight;
+    vec3 axis = abs(direction);
+    int face = axis.x >= axis.y && axis.x >= axis.z ? (direction.x > 0.0 ? 0 : 1)
+             : axis.y >= axis.z ? (direction.y > 0.0 ? 2 : 3) : (direction.z > 0.0 ? 4 : 5);
+    float major = max(axis.x, max(axis.y, axis.z));
+    vec2 uv = 0.5 + 0.5 * vec2(dot(direction, faceRight[face]), dot(direction, faceUp[face])) / major;
+    
+    // stay half a texel inside the face so filtering never reads the neighbouring one
+    float texels = tile.z * float(textureSize(shadowAtlas, 0).x);
+    uv = clamp(uv, 0.5 / texels, 1.0 - 0.5 / texels);
+    uv = tile.xy + (vec2(face % 3, face / 3) + uv) * tile.z;
+    
+    // a shadow texel covers more surface further from the light and at grazing angles
+    float distance = length(direction);
+    float texel = 2.0 * major / texels;
+    float slope = sqrt(1.0 - cosTheta * cosTheta) / max(cosTheta, 0.1);
+    float bias = texel * (1.0 + slope);
+    
+    return texture(shadowAtlas, vec3(uv, (distance - bias) / radius));
+}
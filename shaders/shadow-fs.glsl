@@ -0,0 +1,10 @@
+#version 330 core
+in vec3 FragWorldPos;
+
+// position and radius
+uniform vec4 light;
+
+void main()
+{
+    gl_FragDepth = length(FragWorldPos - light.xyz) / light.w;
+}
@@ -0,0 +1,48 @@
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+in vec3 WorldPos[];
+
+out vec3 FragWorldPos;
+
+uniform mat4 faces[6];
+// atlas position and face size of the light's tile in texture coordinates
+uniform vec4 tile;
+
+void main()
+{
+    for (int face = 0; face < 6; face++) {
+        vec4 clip[3];
+        
+        for (int i = 0; i < 3; i++) clip[i] = faces[face] * vec4(WorldPos[i], 1.0);
+        
+        // skip faces with the whole triangle outside one of their side planes
+        bvec4 outside = bvec4(true);
+        
+        for (int i = 0; i < 3; i++) {
+            outside = bvec4(outside.x && clip[i].x > clip[i].w, outside.y && clip[i].x < -clip[i].w,
+                            outside.z && clip[i].y > clip[i].w, outside.w && clip[i].y < -clip[i].w);
+        }
+        
+        if (any(outside)) continue;
+        
+        // faces sit in a 3x2 block, squeeze the face's clip space into its square of the atlas
+        vec2 corner = tile.xy + vec2(face % 3, face / 3) * tile.z;
+        
+        for (int i = 0; i < 3; i++) {
+            vec4 position = clip[i];
+            
+            gl_ClipDistance[0] = position.w - position.x;
+            gl_ClipDistance[1] = position.w + position.x;
+            gl_ClipDistance[2] = position.w - position.y;
+            gl_ClipDistance[3] = position.w + position.y;
+            
+            gl_Position = vec4((position.xy + position.w) * tile.z + position.w * (2.0 * corner - 1.0), position.zw);
+            FragWorldPos = WorldPos[i];
+            EmitVertex();
+        }
+        
+        EndPrimitive();
+    }
+}
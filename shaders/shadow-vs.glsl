@@ -0,0 +1,11 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in mat4 aModel;
+
+out vec3 WorldPos;
+
+// the geometry shader projects onto each cube face
+void main()
+{
+    WorldPos = vec3(aModel * vec4(aPos, 1.0f));
+}
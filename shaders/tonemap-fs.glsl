@@ -0,0 +1,26 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform sampler2D bloomHalf;
+uniform sampler2D bloomQuarter;
+uniform float bloomStrength;
+
+// Narkowicz's fit of the ACES filmic curve. The lighting is tuned for display values, so nothing is gamma encoded.
+vec3 tonemap(vec3 color)
+{
+    return clamp(color * (2.51f * color + 0.03f) / (color * (2.43f * color + 0.59f) + 0.14f), 0.0f, 1.0f);
+}
+
+void main()
+{
+    vec3 color = texelFetch(scene, ivec2(gl_FragCoord.xy), 0).rgb;
+    
+    if (bloomStrength > 0.0f) {
+        vec2 position = gl_FragCoord.xy / vec2(textureSize(scene, 0));
+        
+        color += bloomStrength * (texture(bloomHalf, position).rgb + texture(bloomQuarter, position).rgb);
+    }
+    
+    FragColor = vec4(tonemap(color), 1.0f);
+}
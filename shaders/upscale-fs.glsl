@@ -0,0 +1,39 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D source;
+// rendered part of the source in texels
+uniform vec2 sourceSize;
+uniform vec2 targetSize;
+// 0 for plain bilinear
+uniform float sharpness;
+
+vec3 sampleSource(vec2 position)
+{
+    // stay half a texel inside the rendered corner, bilinear filtering would blend in what lies outside it
+    position = clamp(position, vec2(0.5f), sourceSize - 0.5f);
+    
+    return texture(source, position / vec2(textureSize(source, 0))).rgb;
+}
+
+void main()
+{
+    vec2 position = gl_FragCoord.xy * sourceSize / targetSize;
+    vec3 color = sampleSource(position);
+    
+    if (sharpness > 0.0f) {
+        vec3 left = sampleSource(position - vec2(1.0f, 0.0f));
+        vec3 right = sampleSource(position + vec2(1.0f, 0.0f));
+        vec3 down = sampleSource(position - vec2(0.0f, 1.0f));
+        vec3 up = sampleSource(position + vec2(0.0f, 1.0f));
+        
+        // unsharp mask, clamped to the neighbourhood so edges do not ring
+        vec3 sharpened = color + sharpness * (4.0f * color - left - right - down - up);
+        vec3 low = min(color, min(min(left, right), min(down, up)));
+        vec3 high = max(color, max(max(left, right), max(down, up)));
+        
+        color = clamp(sharpened, low, high);
+    }
+    
+    FragColor = vec4(color, 1.0f);
+}